@@ -10,14 +10,17 @@ CFileData::CFileData()
     : CData()
     , m_bytes()
     , m_binary_data(true)
+    , m_filename()
 {
 
 }
 
-CFileData::CFileData(bool binary_data, const QByteArray &bytes)
+CFileData::CFileData(bool binary_data, const QByteArray &bytes,
+                     const QString &filename)
     : CData()
     , m_bytes(bytes)
     , m_binary_data(binary_data)
+    , m_filename(filename)
 {
 
 }
@@ -29,7 +32,7 @@ CFileData::CFileData(bool binary_data, const QByteArray &bytes)
 CDataPointer CFileData::clone() const
 {
     CDataPointer clone =
-        CDataPointer(new CFileData(m_binary_data, m_bytes));
+        CDataPointer(new CFileData(m_binary_data, m_bytes, m_filename));
 
     return clone;
 }
@@ -50,6 +53,7 @@ bool CFileData::readFile(QString filename, bool binary)
 
     // Read the entire file into m_bytes.
     m_bytes = file.readAll();
+    m_filename = filename;
 
     return true;
 }
@@ -59,6 +63,11 @@ bool CFileData::isDataBinary() const
     return m_binary_data;
 }
 
+const QString &CFileData::getFilename() const
+{
+    return m_filename;
+}
+
 const QByteArray &CFileData::getBytes() const
 {
     return m_bytes;
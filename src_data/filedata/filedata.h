@@ -3,6 +3,7 @@
 
 #include "data/data.h"
 #include <QByteArray>
+#include <QString>
 
 class CFileData: public CData
 {
@@ -11,6 +12,8 @@ class CFileData: public CData
     virtual CDataPointer clone() const;
     bool readFile(QString filename, bool binary);
     bool isDataBinary() const;
+    // The name of the file the bytes were read from (empty if none).
+    const QString &getFilename() const;
     const QByteArray &getBytes() const;
     int numBytes() const;
     void setByte(int offset, quint8 byte);
@@ -18,9 +21,11 @@ class CFileData: public CData
   private:
     QByteArray m_bytes;
     bool m_binary_data;
+    QString m_filename;
 
     // Constructor for cloning this object.
-    explicit CFileData(bool binary_data, const QByteArray &bytes);
+    explicit CFileData(bool binary_data, const QByteArray &bytes,
+                       const QString &filename);
 };
 
 #endif // FILEDATA_H
@@ -0,0 +1,63 @@
+#include "compiledrules.h"
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CCompiledRules::CCompiledRules()
+    : m_rule_count(0)
+    , m_width(0)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+void CCompiledRules::compile(const QList<CRule> &rules, qint32 attribute_count)
+{
+    m_rule_count = rules.size();
+    m_width = (attribute_count + 3) & ~3;
+    m_masks.fill(0, m_rule_count * m_width);
+    m_values.fill(0, m_rule_count * m_width);
+    m_consequents.resize(m_rule_count);
+    m_allowed_offsets.resize(m_rule_count + 1);
+    m_allowed.clear();
+
+    for(qint32 i = 0; i < m_rule_count; ++i) {
+        const CRule &rule = rules.at(i);
+        // Only the attributes checked by CRule::matchAntecedents().
+        for(qint32 attribute : rule.i_antecedents) {
+            m_masks[i * m_width + attribute] = ~0;
+            m_values[i * m_width + attribute] = rule.antecedent[attribute];
+        }
+        m_consequents[i] = rule.i_consequent < attribute_count ?
+                    rule.i_consequent : -1;
+
+        // The keys of the map are already sorted.
+        m_allowed_offsets[i] = m_allowed.size();
+        for(auto it = rule.consequent.values.constBegin();
+            it != rule.consequent.values.constEnd(); ++it) {
+            m_allowed.append(it.key());
+        }
+    }
+    m_allowed_offsets[m_rule_count] = m_allowed.size();
+}
+
+quint64 CCompiledRules::fires(qint32 rule, const Nominal *tuples,
+                              qint32 count) const
+{
+    quint64 result = 0;
+    if(m_allowed_offsets.at(rule) == m_allowed_offsets.at(rule + 1)) {
+        return result;
+    }
+
+    for(qint32 i = 0; i < count; ++i, tuples += m_width) {
+        if(matchAntecedents(rule, tuples) && !matchConsequent(rule, tuples)) {
+            result |= Q_UINT64_C(1) << i;
+        }
+    }
+
+    return result;
+}
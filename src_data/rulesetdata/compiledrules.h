@@ -0,0 +1,113 @@
+#ifndef COMPILEDRULES_H
+#define COMPILEDRULES_H
+
+#include "rule.h"
+#include "ruletypes.h"
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__SSE2__))
+#define COMPILEDRULES_SSE2
+#include <emmintrin.h>
+#endif
+
+
+// The rules of a ruleset flattened into arrays for evaluation. Every
+// ... antecedent is a row of 'width()' values and a mask that is zero for the
+// ... attributes it does not constrain, so a tuple is matched comparing four
+// ... attributes at a time. The values allowed by the consequents are kept
+// ... sorted in a single array. Tuples are rows of 'width()' nominals; the
+// ... padding after the last attribute is ignored.
+class CCompiledRules
+{
+  private:
+    qint32 m_rule_count;
+    // The attributes rounded up to a multiple of four.
+    qint32 m_width;
+    // The masks and the masked values of the antecedents of every rule.
+    QVector<Nominal> m_masks;
+    QVector<Nominal> m_values;
+    // The attribute of the consequent of every rule (-1 if none).
+    QVector<qint32> m_consequents;
+    // The allowed values of rule 'i' are in [m_allowed_offsets[i],
+    // ... m_allowed_offsets[i + 1]) of 'm_allowed'.
+    QVector<qint32> m_allowed_offsets;
+    QVector<Nominal> m_allowed;
+
+  public:
+    explicit CCompiledRules();
+    // Flatten 'rules' over 'attribute_count' attributes.
+    void compile(const QList<CRule> &rules, qint32 attribute_count);
+    qint32 ruleCount() const { return m_rule_count; }
+    qint32 width() const { return m_width; }
+    // Same as CRule::matchAntecedents() and CRule::matchConsequent().
+    inline bool matchAntecedents(qint32 rule, const Nominal *tuple) const;
+    inline bool matchConsequent(qint32 rule, const Nominal *tuple) const;
+    // Does 'rule' flag 'tuple' as anomalous? Its antecedents have to match
+    // ... and its consequent has to have values, none of them matching.
+    inline bool fires(qint32 rule, const Nominal *tuple) const;
+    // Set bit 'i' of the result if 'rule' fires for tuple 'i' of the
+    // ... 'count' (at most 64) consecutive 'tuples'.
+    quint64 fires(qint32 rule, const Nominal *tuples, qint32 count) const;
+};
+
+
+// Inline functions
+
+bool CCompiledRules::matchAntecedents(qint32 rule, const Nominal *tuple) const
+{
+    const Nominal *masks = m_masks.constData() + rule * m_width;
+    const Nominal *values = m_values.constData() + rule * m_width;
+
+#ifdef COMPILEDRULES_SSE2
+    for(qint32 i = 0; i < m_width; i += 4) {
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tuple + i));
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks + i));
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(t, m), v)) != 0xffff) {
+            return false;
+        }
+    }
+#else
+    for(qint32 i = 0; i < m_width; ++i) {
+        if((tuple[i] & masks[i]) != values[i]) {
+            return false;
+        }
+    }
+#endif
+
+    return true;
+}
+
+bool CCompiledRules::matchConsequent(qint32 rule, const Nominal *tuple) const
+{
+    qint32 attribute = m_consequents.at(rule);
+    if(attribute < 0) {
+        return false;
+    }
+
+    Nominal value = tuple[attribute];
+    const Nominal *first = m_allowed.constData() + m_allowed_offsets.at(rule);
+    const Nominal *last = m_allowed.constData() + m_allowed_offsets.at(rule + 1);
+    if(last - first <= 8) {
+        // Most consequents allow a few values.
+        for(; first != last; ++first) {
+            if(*first == value) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    return std::binary_search(first, last, value);
+}
+
+bool CCompiledRules::fires(qint32 rule, const Nominal *tuple) const
+{
+    return m_allowed_offsets.at(rule) != m_allowed_offsets.at(rule + 1) &&
+           matchAntecedents(rule, tuple) && !matchConsequent(rule, tuple);
+}
+
+#endif // COMPILEDRULES_H
@@ -16,6 +16,8 @@ class CConsequent
     CConsequent(Nominal v): n(0), t(0) { values[v] = 1; }
 
     qint32 add(Nominal v) {++n; return ++values[v];}
+    // Add 'weight' copies of a value.
+    qint32 add(Nominal v, qint32 weight) {n += weight; return values[v] += weight;}
     void clear() { values.clear(); n = 0; t = 0; }
     bool find(Nominal n) const { return values.find(n) != values.constEnd(); }
     qint32 valuesCount() const { return values.size(); }
@@ -1,5 +1,52 @@
 #include "rulesetdata.h"
 #include <QDebug>
+#include <QByteArray>
+#include <algorithm>
+
+namespace {
+    // The nominals of an antecedent as bytes, to find identical rules.
+    QByteArray antecedentKey(const Antecedent &antecedent)
+    {
+        QByteArray key;
+        key.reserve(antecedent.size() * sizeof(Nominal));
+        for(Nominal nominal : antecedent) {
+            key.append(reinterpret_cast<const char *>(&nominal), sizeof(Nominal));
+        }
+        return key;
+    }
+
+    // Are the rules equal?
+    bool sameRule(const CRule &a, const CRule &b)
+    {
+        return a.antecedent == b.antecedent &&
+                a.consequent.values.keys() == b.consequent.values.keys();
+    }
+
+    // Does 'general' fire every time 'rule' fires? Both have to predict the
+    // ... same attribute, the antecedents of 'general' have to be a subset
+    // ... of the ones of 'rule' and its values a subset of the values of
+    // ... 'rule'.
+    bool generalizes(const CRule &general, const CRule &rule)
+    {
+        if(general.i_consequent != rule.i_consequent ||
+           general.i_antecedents.size() > rule.i_antecedents.size()) {
+            return false;
+        }
+        // Only the antecedents in i_antecedents are matched.
+        for(qint32 i : general.i_antecedents) {
+            if(rule.antecedent[i] != general.antecedent[i]) {
+                return false;
+            }
+        }
+        for(auto it = general.consequent.values.constBegin();
+            it != general.consequent.values.constEnd(); ++it) {
+            if(!rule.consequent.find(it.key())) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
 
 
 //------------------------------------------------------------------------------
@@ -8,6 +55,7 @@
 CRulesetData::CRulesetData()
     : CData()
     , m_attributes(0)
+    , m_tuples(0)
 {
 
 }
@@ -29,7 +77,180 @@ CDataPointer CRulesetData::clone() const
     return QSharedPointer<CRulesetData>(ruleset_clone);
 }
 
+void CRulesetData::compile()
+{
+    buildIndex();
+    m_compiled.compile(m_ruleset, m_attributes);
+}
+
+void CRulesetData::candidateRules(const Nominal *tuple,
+                                  QVector<qint32> &candidates) const
+{
+    candidates = m_unconstrained;
+
+    for(qint32 i = 0; i < m_index.size(); ++i) {
+        const QHash<Nominal, QVector<qint32>> &values = m_index.at(i);
+        if(values.isEmpty()) {
+            continue;
+        }
+        auto it = values.constFind(tuple[i]);
+        if(it != values.constEnd()) {
+            candidates += it.value();
+        }
+    }
+
+    // Each rule is in a single list.
+    std::sort(candidates.begin(), candidates.end());
+}
+
+bool CRulesetData::merge(const CRulesetData &ruleset)
+{
+    if(m_ruleset.isEmpty() && m_attributes == 0) {
+        m_attributes = ruleset.m_attributes;
+    }
+    if(ruleset.m_attributes != m_attributes) {
+        return false;
+    }
+
+    // Antecedents use 0 and 1 for "*" and "?", the other nominals are
+    // ... translated to this dictionary.
+    string2nominal("*");
+    string2nominal("?");
+    QVector<Nominal> translation;
+    translation.reserve(ruleset.m_nominal2string.size());
+    for(const QString &string : ruleset.m_nominal2string) {
+        translation.append(string2nominal(string));
+    }
+
+    QHash<QByteArray, qint32> positions;
+    for(qint32 i = 0; i < m_ruleset.size(); ++i) {
+        positions.insert(antecedentKey(m_ruleset.at(i).antecedent), i);
+    }
+
+    for(const CRule &rule : ruleset.m_ruleset) {
+        Antecedent antecedent = rule.antecedent;
+        for(Nominal &nominal : antecedent) {
+            if(nominal > 1) {
+                nominal = translation.at(nominal);
+            }
+        }
+
+        // The times of the other rules start after our tuples.
+        CConsequent consequent;
+        consequent.n = rule.consequent.n;
+        consequent.t = rule.consequent.t > 0 ? m_tuples + rule.consequent.t : 0;
+        for(auto it = rule.consequent.values.constBegin();
+            it != rule.consequent.values.constEnd(); ++it) {
+            consequent.values[translation.at(it.key())] += it.value();
+        }
+
+        QByteArray key = antecedentKey(antecedent);
+        auto it = positions.constFind(key);
+        if(it == positions.constEnd()) {
+            positions.insert(key, m_ruleset.size());
+            m_ruleset.append(CRule(antecedent, consequent));
+        }
+        else {
+            CConsequent &merged = m_ruleset[it.value()].consequent;
+            merged.n += consequent.n;
+            merged.t = qMax(merged.t, consequent.t);
+            for(auto value = consequent.values.constBegin();
+                value != consequent.values.constEnd(); ++value) {
+                merged.values[value.key()] += value.value();
+            }
+        }
+    }
+    m_tuples += ruleset.m_tuples;
+
+    // Keep the rules sorted by n/r.
+    std::sort(m_ruleset.begin(), m_ruleset.end());
+
+    return true;
+}
+
+SPruneReport CRulesetData::prune(qint32 max_rules/* = 0*/)
+{
+    SPruneReport report;
+    report.duplicates = 0;
+    report.dominated = 0;
+    report.capped = 0;
+
+    // Go through the rules from the best to the worst n/r. The rules kept
+    // ... before a rule have the same or better n/r.
+    QVector<qint32> order(m_ruleset.size());
+    for(qint32 i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&] (qint32 a, qint32 b) {
+        return m_ruleset.at(a) < m_ruleset.at(b);
+    });
+
+    // The rules kept for every attribute.
+    QHash<qint32, QVector<qint32>> kept;
+    QVector<bool> keep(m_ruleset.size(), false);
+    qint32 kept_count = 0;
+    for(qint32 i : order) {
+        const CRule &rule = m_ruleset.at(i);
+        QVector<qint32> &better = kept[rule.i_consequent];
+
+        bool removed = false;
+        for(qint32 j : better) {
+            const CRule &general = m_ruleset.at(j);
+            if(sameRule(general, rule)) {
+                ++report.duplicates;
+                removed = true;
+                break;
+            }
+            if(generalizes(general, rule)) {
+                ++report.dominated;
+                removed = true;
+                break;
+            }
+        }
+        if(removed) {
+            continue;
+        }
+
+        if(max_rules > 0 && kept_count >= max_rules) {
+            ++report.capped;
+            continue;
+        }
+        better.append(i);
+        keep[i] = true;
+        ++kept_count;
+    }
+
+    QList<CRule> rules;
+    rules.reserve(kept_count);
+    for(qint32 i = 0; i < m_ruleset.size(); ++i) {
+        if(keep.at(i)) {
+            rules.append(m_ruleset.at(i));
+        }
+    }
+    m_ruleset.swap(rules);
+
+    return report;
+}
+
 
 //------------------------------------------------------------------------------
 // Private Functions
 
+void CRulesetData::buildIndex()
+{
+    m_index.clear();
+    m_index.resize(m_attributes);
+    m_unconstrained.clear();
+
+    for(qint32 i = 0; i < m_ruleset.size(); ++i) {
+        const CRule &rule = m_ruleset.at(i);
+        // A rule only matches tuples with the value of its first antecedent.
+        if(rule.i_antecedents.isEmpty()) {
+            m_unconstrained.append(i);
+        }
+        else {
+            qint32 attribute = rule.i_antecedents.first();
+            m_index[attribute][rule.antecedent[attribute]].append(i);
+        }
+    }
+}
@@ -3,9 +3,24 @@
 
 #include "rule.h"
 #include "ruletypes.h"
+#include "compiledrules.h"
 #include "data/data.h"
 #include <QtGlobal>
 #include <QtDebug>
+#include <QVector>
+#include <QHash>
+
+
+// What pruning a ruleset removed.
+struct SPruneReport {
+    // Rules with the antecedent and consequent of a better rule.
+    qint32 duplicates;
+    // Rules that only fire when a more general rule with the same or better
+    // ... n/r fires too.
+    qint32 dominated;
+    // Rules removed to keep the maximum number of rules.
+    qint32 capped;
+};
 
 
 class CRulesetData: public CData
@@ -20,6 +35,12 @@ class CRulesetData: public CData
     qint32 m_attributes;
     // Number of tuples used to build this ruleset.
     qint32 m_tuples;
+    // The rules indexed by the first attribute value their antecedents
+    // ... constrain, and the rules without constraints.
+    QVector<QHash<Nominal, QVector<qint32>>> m_index;
+    QVector<qint32> m_unconstrained;
+    // The rules flattened for evaluation.
+    CCompiledRules m_compiled;
 
   public:
     explicit CRulesetData();
@@ -30,6 +51,8 @@ class CRulesetData: public CData
     // Retreive or add a string to nominal.
     inline qint32 string2nominal(QString string);
     QString nominal2string(qint32 nominal) { return m_nominal2string[nominal]; }
+    // Get the nominal of a string without adding it, -1 if it has none.
+    inline qint32 findNominal(const QString &string) const;
     // Create a rule from a list of antecedents and add it.
     inline void addRule(Antecedent &a);
     // Get a modifiable list of all rules.
@@ -39,6 +62,7 @@ class CRulesetData: public CData
     qint32 size() { return m_ruleset.size(); }
     // Return the list of all available nominal attributes.
     QList<QString> &getNominals() { return m_nominal2string; }
+    const QList<QString> &getNominals() const { return m_nominal2string; }
     // Set the number of attributes used to create the ruleset.
     void attributeCount(qint32 count) { m_attributes = count; }
     // Get the number of attrbitues used for the ruleset.
@@ -47,6 +71,28 @@ class CRulesetData: public CData
     void tuplesCount(qint32 count) { m_tuples = count; }
     // Get the tuples used.
     qint32 tuplesCount() const { return m_tuples; }
+    // Index and flatten the rules before evaluating them. This has to be
+    // ... done again after the rules are changed.
+    void compile();
+    // The flattened rules. Tuples have 'compiled().width()' nominals.
+    const CCompiledRules &compiled() const { return m_compiled; }
+    // Get the indices of the rules whose antecedents can match 'tuple', in
+    // ... the order of the rules. The rules still have to be matched.
+    void candidateRules(const Nominal *tuple,
+                        QVector<qint32> &candidates) const;
+    // Add the rules of a ruleset trained with the tuples that follow ours.
+    // ... Its nominals are translated to this dictionary and the support of
+    // ... identical rules is added, which approximates their support on all
+    // ... the tuples. Return false if the number of attributes is different.
+    bool merge(const CRulesetData &ruleset);
+    // Remove duplicated and dominated rules and, if 'max_rules' is not 0,
+    // ... the lowest ranked rules over that number. The order of the rules
+    // ... left does not change.
+    SPruneReport prune(qint32 max_rules = 0);
+
+  private:
+    // Index the rules by the values of their antecedents.
+    void buildIndex();
 };
 
 
@@ -66,6 +112,11 @@ qint32 CRulesetData::string2nominal(QString string)
     return n;
 }
 
+qint32 CRulesetData::findNominal(const QString &string) const
+{
+    return m_string2nominal.value(string, -1);
+}
+
 void CRulesetData::addRule(Antecedent &a) {
     if(a.size() != m_attributes) {
         qWarning() << "Will NOT add rule with non-matching attributes' size.";
@@ -29,6 +29,9 @@ QMAKE_CLEAN += $$DESTDIR/*$$TARGET*
 
 HEADERS += \
     rulesetdata.h \
+    compiledrules.h \
+    rulesetfile.h \
+    uniquetuples.h \
     interface.h \
     consequent.h \
     rule.h \
@@ -36,5 +39,8 @@ HEADERS += \
 
 SOURCES += \
     rulesetdata.cpp \
+    compiledrules.cpp \
+    rulesetfile.cpp \
+    uniquetuples.cpp \
     interface.cpp
 
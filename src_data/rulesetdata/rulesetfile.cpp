@@ -0,0 +1,202 @@
+#include "rulesetfile.h"
+#include <QByteArray>
+#include <QFile>
+#include <QtEndian>
+
+namespace {
+    const quint32 MAGIC = 0x414e5253; // "ANRS"
+    const quint32 VERSION = 1;
+    // The magic, version and counts at the beginning of the file.
+    const qint32 HEAD_SIZE = 24;
+
+    void appendUInt32(QByteArray &bytes, quint32 value)
+    {
+        uchar data[4];
+        qToLittleEndian<quint32>(value, data);
+        bytes.append(reinterpret_cast<const char *>(data), sizeof(data));
+    }
+
+    // Read little endian numbers from a mapped file without going past its
+    // ... end. Once a read fails all the following ones fail too.
+    struct SReader {
+        const uchar *data;
+        qint64 size;
+        qint64 position;
+        bool ok;
+
+        const uchar *bytes(qint64 count)
+        {
+            if(!ok || count < 0 || size - position < count) {
+                ok = false;
+                return nullptr;
+            }
+            const uchar *bytes = data + position;
+            position += count;
+            return bytes;
+        }
+
+        quint32 uint32()
+        {
+            const uchar *bytes = this->bytes(4);
+            return bytes == nullptr ? 0 : qFromLittleEndian<quint32>(bytes);
+        }
+
+        qint32 int32()
+        {
+            return static_cast<qint32>(uint32());
+        }
+    };
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+bool CRulesetFile::save(const CRulesetData &ruleset, const QString &filename)
+{
+    const QList<QString> &nominals = ruleset.getNominals();
+    const QList<CRule> &rules = ruleset.getRules();
+    qint32 attribute_count = ruleset.attributeCount();
+
+    // Check the rules before the file is touched so that an invalid ruleset
+    // ... does not leave a truncated file behind.
+    for(const CRule &rule : rules) {
+        if(rule.antecedent.size() != attribute_count) {
+            return false;
+        }
+    }
+
+    QFile file(filename);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    QByteArray bytes;
+    appendUInt32(bytes, MAGIC);
+    appendUInt32(bytes, VERSION);
+    appendUInt32(bytes, attribute_count);
+    appendUInt32(bytes, ruleset.tuplesCount());
+    appendUInt32(bytes, nominals.size());
+    appendUInt32(bytes, rules.size());
+
+    // The dictionary: where every nominal ends followed by all of them.
+    QByteArray strings;
+    for(const QString &nominal : nominals) {
+        strings.append(nominal.toUtf8());
+        appendUInt32(bytes, strings.size());
+    }
+    bytes.append(strings);
+    strings.clear();
+
+    for(const CRule &rule : rules) {
+        appendUInt32(bytes, rule.consequent.n);
+        appendUInt32(bytes, rule.consequent.t);
+        appendUInt32(bytes, rule.consequent.values.size());
+        for(Nominal nominal : rule.antecedent) {
+            appendUInt32(bytes, nominal);
+        }
+        for(auto it = rule.consequent.values.constBegin();
+            it != rule.consequent.values.constEnd(); ++it) {
+            appendUInt32(bytes, it.key());
+            appendUInt32(bytes, it.value());
+        }
+        if(bytes.size() > (1 << 24)) {
+            if(file.write(bytes) != bytes.size()) {
+                return false;
+            }
+            bytes.clear();
+        }
+    }
+    appendUInt32(bytes, MAGIC);
+
+    return file.write(bytes) == bytes.size() && file.flush();
+}
+
+bool CRulesetFile::load(const QString &filename, CRulesetData &ruleset,
+                        QString &error)
+{
+    if(!ruleset.getNominals().isEmpty() || !ruleset.getRules().isEmpty()) {
+        error = "Rulesets can only be read into empty rulesets.";
+        return false;
+    }
+
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly)) {
+        error = "Could not open " + filename;
+        return false;
+    }
+
+    qint64 size = file.size();
+    const uchar *data = size >= HEAD_SIZE + 4 ? file.map(0, size) : nullptr;
+    if(data == nullptr ||
+       qFromLittleEndian<quint32>(data) != MAGIC ||
+       qFromLittleEndian<quint32>(data + size - 4) != MAGIC) {
+        error = filename + " is not a ruleset file.";
+        return false;
+    }
+    if(qFromLittleEndian<quint32>(data + 4) != VERSION) {
+        error = filename + " has an unknown version.";
+        return false;
+    }
+
+    SReader in = {data, size - 4, 8, true};
+    qint32 attribute_count = in.int32();
+    qint32 tuple_count = in.int32();
+    qint32 nominal_count = in.int32();
+    qint32 rule_count = in.int32();
+    if(attribute_count < 0 || tuple_count < 0 || nominal_count < 0 ||
+       rule_count < 0) {
+        error = filename + " is corrupt.";
+        return false;
+    }
+    ruleset.attributeCount(attribute_count);
+    ruleset.tuplesCount(tuple_count);
+
+    // Read the dictionary. Every nominal has to get its own position.
+    const uchar *ends = in.bytes(static_cast<qint64>(nominal_count) * 4);
+    quint32 strings_size = nominal_count > 0 && ends != nullptr ?
+                qFromLittleEndian<quint32>(ends + (nominal_count - 1) * 4) : 0;
+    const char *strings = reinterpret_cast<const char *>(in.bytes(strings_size));
+    quint32 begin = 0;
+    for(qint32 i = 0; in.ok && i < nominal_count; ++i) {
+        quint32 end = qFromLittleEndian<quint32>(ends + i * 4);
+        if(end < begin || end > strings_size) {
+            in.ok = false;
+            break;
+        }
+        QString nominal = QString::fromUtf8(strings + begin, end - begin);
+        in.ok = ruleset.string2nominal(nominal) == i;
+        begin = end;
+    }
+
+    QList<CRule> &rules = ruleset.getRules();
+    rules.reserve(rule_count);
+    Antecedent antecedent;
+    for(qint32 i = 0; in.ok && i < rule_count; ++i) {
+        CConsequent consequent;
+        consequent.n = in.int32();
+        consequent.t = in.int32();
+        qint32 value_count = in.int32();
+        antecedent.clear();
+        for(qint32 j = 0; in.ok && j < attribute_count; ++j) {
+            Nominal nominal = in.int32();
+            in.ok = in.ok && nominal >= 0 && nominal < nominal_count;
+            antecedent.append(nominal);
+        }
+        for(qint32 j = 0; in.ok && j < value_count; ++j) {
+            Nominal nominal = in.int32();
+            qint32 count = in.int32();
+            in.ok = in.ok && nominal >= 0 && nominal < nominal_count;
+            consequent.values[nominal] = count;
+        }
+        rules.append(CRule(antecedent, consequent));
+    }
+
+    if(!in.ok || in.position != in.size) {
+        rules.clear();
+        error = filename + " is corrupt.";
+        return false;
+    }
+
+    return true;
+}
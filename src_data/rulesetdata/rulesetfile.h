@@ -0,0 +1,23 @@
+#ifndef RULESETFILE_H
+#define RULESETFILE_H
+
+#include "rulesetdata.h"
+#include <QString>
+
+
+// Binary files of rulesets: the attribute and tuple counts, the dictionary
+// ... of nominals and every rule with its antecedent, support, time of the
+// ... last anomaly and allowed values with their counts. Numbers are little
+// ... endian and files are read by mapping them.
+class CRulesetFile
+{
+  public:
+    // Write 'ruleset' to 'filename'. Return false if it could not be written.
+    static bool save(const CRulesetData &ruleset, const QString &filename);
+    // Read 'filename' into the empty 'ruleset'. Set 'error' if the file
+    // ... cannot be read.
+    static bool load(const QString &filename, CRulesetData &ruleset,
+                     QString &error);
+};
+
+#endif // RULESETFILE_H
@@ -0,0 +1,88 @@
+#include "uniquetuples.h"
+#include <cstring>
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CUniqueTuples::CUniqueTuples()
+    : m_width(0)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+void CUniqueTuples::build(const Nominal *tuples, qint32 count, qint32 width)
+{
+    m_width = width;
+    m_tuples.clear();
+    m_hashes.clear();
+    m_weights.clear();
+    m_first.clear();
+    m_index.resize(count);
+
+    // An open addressing table of distinct tuples with at least twice as
+    // ... many slots as tuples. Empty slots are -1.
+    qint32 slot_count = 16;
+    while(slot_count < 2 * count) {
+        slot_count <<= 1;
+    }
+    QVector<qint32> slots_table(slot_count, -1);
+    quint64 mask = slot_count - 1;
+
+    for(qint32 i = 0; i < count; ++i) {
+        const Nominal *tuple = tuples + static_cast<qint64>(i) * width;
+        quint64 h = hash(tuple, width);
+
+        quint64 slot = h & mask;
+        while(true) {
+            qint32 unique = slots_table.at(slot);
+            if(unique == -1) {
+                // A new distinct tuple.
+                unique = m_weights.size();
+                slots_table[slot] = unique;
+                for(qint32 j = 0; j < width; ++j) {
+                    m_tuples.append(tuple[j]);
+                }
+                m_hashes.append(h);
+                m_weights.append(1);
+                m_first.append(i);
+                m_index[i] = unique;
+                break;
+            }
+            const Nominal *stored =
+                    m_tuples.constData() + static_cast<qint64>(unique) * width;
+            if(m_hashes.at(unique) == h &&
+               std::memcmp(stored, tuple, width * sizeof(Nominal)) == 0) {
+                ++m_weights[unique];
+                m_index[i] = unique;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Private Functions
+
+quint64 CUniqueTuples::hash(const Nominal *tuple, qint32 width)
+{
+    // FNV-1a over the nominals followed by the finalizer of MurmurHash3, so
+    // ... that the low bits used by the table are well mixed.
+    quint64 h = Q_UINT64_C(0xcbf29ce484222325);
+    for(qint32 j = 0; j < width; ++j) {
+        h = (h ^ static_cast<quint32>(tuple[j])) * Q_UINT64_C(0x100000001b3);
+    }
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+
+    return h;
+}
@@ -0,0 +1,44 @@
+#ifndef UNIQUETUPLES_H
+#define UNIQUETUPLES_H
+
+#include "ruletypes.h"
+#include <QtGlobal>
+#include <QVector>
+
+
+// The distinct tuples of a row-major matrix of nominals. They are numbered
+// ... in the order they first appear and each one knows how many times it
+// ... appears, so that work done on a tuple can be done once for all of its
+// ... copies.
+class CUniqueTuples
+{
+  private:
+    qint32 m_width;
+    // The distinct tuples as a row-major matrix and their hashes.
+    QVector<Nominal> m_tuples;
+    QVector<quint64> m_hashes;
+    // Times every distinct tuple appears and the index of its first copy.
+    QVector<qint32> m_weights;
+    QVector<qint32> m_first;
+    // The distinct tuple of every tuple of the matrix.
+    QVector<qint32> m_index;
+
+  public:
+    explicit CUniqueTuples();
+    // Collapse 'count' tuples of 'width' nominals.
+    void build(const Nominal *tuples, qint32 count, qint32 width);
+    // The number of distinct tuples.
+    qint32 size() const { return m_weights.size(); }
+    qint32 width() const { return m_width; }
+    // The distinct tuples as a matrix of 'size()' rows.
+    const Nominal *tuples() const { return m_tuples.constData(); }
+    qint32 weight(qint32 unique) const { return m_weights.at(unique); }
+    qint32 first(qint32 unique) const { return m_first.at(unique); }
+    // Get the distinct tuple of tuple 'tuple' of the matrix.
+    qint32 index(qint32 tuple) const { return m_index.at(tuple); }
+
+  private:
+    static quint64 hash(const Nominal *tuple, qint32 width);
+};
+
+#endif // UNIQUETUPLES_H
@@ -1,5 +1,282 @@
 #include "tabledata.h"
 #include <QDebug>
+#include <QPair>
+#include <QStringList>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+    // The keys of a column used to sort a table. Every row gets one or more
+    // ... words compared from the first to the last and then, in columns
+    // ... that hold text, its string. The words are inverted for a
+    // ... descending column.
+    struct SKeyColumn {
+        bool ascending;
+        QVector<QVector<quint64>> words;
+        QVector<QString> strings;
+    };
+
+    const quint64 SIGN_BIT = Q_UINT64_C(1) << 63;
+
+    // The values of a column go in the order: nulls, numbers (by value)
+    // ... and text.
+    enum class EKeyType {null, integer, real, text};
+
+    EKeyType keyType(const QVariant &value)
+    {
+        if(value.isNull()) {
+            return EKeyType::null;
+        }
+
+        switch(static_cast<QMetaType::Type>(value.userType())) {
+        case QMetaType::Bool:
+        case QMetaType::Char:
+        case QMetaType::SChar:
+        case QMetaType::Short:
+        case QMetaType::Int:
+        case QMetaType::Long:
+        case QMetaType::LongLong:
+        case QMetaType::UChar:
+        case QMetaType::UShort:
+        case QMetaType::UInt:
+            return EKeyType::integer;
+        case QMetaType::ULong:
+        case QMetaType::ULongLong:
+            // Only values that fit a signed integer are compared as such.
+            if(value.toULongLong() > static_cast<quint64>(
+                   std::numeric_limits<qint64>::max())) {
+                return EKeyType::real;
+            }
+            return EKeyType::integer;
+        case QMetaType::Float:
+        case QMetaType::Double:
+            return EKeyType::real;
+        default:
+            return EKeyType::text;
+        }
+    }
+
+    qint32 keyRank(EKeyType type)
+    {
+        switch(type) {
+        case EKeyType::null:
+            return 0;
+        case EKeyType::integer:
+        case EKeyType::real:
+            return 1;
+        default:
+            return 2;
+        }
+    }
+
+    // Map a real to an unsigned integer that keeps its order. Negative
+    // ... numbers reverse their order.
+    quint64 realKey(double real)
+    {
+        quint64 number;
+        std::memcpy(&number, &real, sizeof(number));
+        return number & SIGN_BIT ? ~number : number | SIGN_BIT;
+    }
+
+    quint64 integerKey(qint64 integer)
+    {
+        return static_cast<quint64>(integer) ^ SIGN_BIT;
+    }
+
+    // Compare two numbers by value. Integers are also compared exactly, so
+    // ... they keep their order when they do not fit a double, and a real
+    // ... goes before an integer with the same value.
+    qint32 compareNumbers(const QVariant &value1, EKeyType type1,
+                          const QVariant &value2, EKeyType type2)
+    {
+        if(type1 == EKeyType::integer && type2 == EKeyType::integer) {
+            qint64 integer1 = value1.toLongLong();
+            qint64 integer2 = value2.toLongLong();
+            return integer1 < integer2 ? -1 : integer2 < integer1 ? 1 : 0;
+        }
+
+        quint64 real1 = realKey(value1.toDouble());
+        quint64 real2 = realKey(value2.toDouble());
+        if(real1 != real2) {
+            return real1 < real2 ? -1 : 1;
+        }
+        if(type1 != type2) {
+            return type1 == EKeyType::real ? -1 : 1;
+        }
+        return 0;
+    }
+
+    // Run 'function' on ranges of rows spread among the threads.
+    template<typename F>
+    void forRanges(qint32 row_count, F function)
+    {
+        QVector<QPair<qint32, qint32>> ranges;
+        const qint32 range_size = 16384;
+        for(qint32 i = 0; i < row_count; i += range_size) {
+            ranges.append(qMakePair(i, qMin(i + range_size, row_count)));
+        }
+        QtConcurrent::blockingMap(ranges, function);
+    }
+
+    SKeyColumn keyColumn(const QList<QList<QVariant>> &table,
+                         const CTableData::SSortKey &key)
+    {
+        SKeyColumn column;
+        column.ascending = key.ascending;
+        qint32 row_count = table.size();
+
+        // Only the words needed by the types found in the column are made.
+        // ... They follow the order of compareNumbers(): the rank of the
+        // ... type, the value as a real, reals before integers and the
+        // ... exact integer.
+        bool found[4] = {false, false, false, false};
+        for(qint32 i = 0; i < row_count; ++i) {
+            found[static_cast<qint32>(keyType(table.at(i).value(key.field)))] = true;
+        }
+        bool has_null = found[static_cast<qint32>(EKeyType::null)];
+        bool has_integer = found[static_cast<qint32>(EKeyType::integer)];
+        bool has_real = found[static_cast<qint32>(EKeyType::real)];
+        bool has_text = found[static_cast<qint32>(EKeyType::text)];
+        bool has_number = has_integer || has_real;
+
+        bool rank_word = has_null + has_number + has_text > 1;
+        bool real_word = has_real;
+        bool flag_word = has_integer && has_real;
+        bool integer_word = has_integer;
+        qint32 word_count = rank_word + real_word + flag_word + integer_word;
+
+        column.words.resize(word_count);
+        for(QVector<quint64> &word : column.words) {
+            word.resize(row_count);
+        }
+        QVector<quint64 *> word_data;
+        for(QVector<quint64> &word : column.words) {
+            word_data.append(word.data());
+        }
+        if(has_text) {
+            column.strings.resize(row_count);
+        }
+        QString *strings = column.strings.data();
+
+        forRanges(row_count, [&] (const QPair<qint32, qint32> &range) {
+            for(qint32 i = range.first; i < range.second; ++i) {
+                const QVariant value = table.at(i).value(key.field);
+                EKeyType type = keyType(value);
+                bool number = type == EKeyType::integer || type == EKeyType::real;
+
+                quint64 words[4];
+                qint32 w = 0;
+                if(rank_word) {
+                    words[w++] = keyRank(type);
+                }
+                if(real_word) {
+                    words[w++] = number ? realKey(value.toDouble()) : 0;
+                }
+                if(flag_word) {
+                    words[w++] = type == EKeyType::integer;
+                }
+                if(integer_word) {
+                    words[w++] = type == EKeyType::integer ?
+                                integerKey(value.toLongLong()) : 0;
+                }
+                for(qint32 j = 0; j < w; ++j) {
+                    word_data.at(j)[i] = key.ascending ? words[j] : ~words[j];
+                }
+
+                if(type == EKeyType::text) {
+                    strings[i] = value.toString();
+                }
+            }
+        });
+
+        return column;
+    }
+
+    // Stable LSD radix sort of 'order' by 'numbers', a byte at a time.
+    void radixSort(const QVector<quint64> &numbers, QVector<qint32> &order)
+    {
+        qint32 row_count = order.size();
+        QVector<qint32> sorted(row_count);
+
+        for(qint32 shift = 0; shift < 64; shift += 8) {
+            qint32 counts[256] = {0};
+            for(qint32 row : order) {
+                ++counts[(numbers.at(row) >> shift) & 0xff];
+            }
+            // Skip the bytes that are the same in every row.
+            if(*std::max_element(counts, counts + 256) == row_count) {
+                continue;
+            }
+
+            qint32 position = 0;
+            for(qint32 &count : counts) {
+                qint32 next = position + count;
+                count = position;
+                position = next;
+            }
+            for(qint32 row : order) {
+                sorted[counts[(numbers.at(row) >> shift) & 0xff]++] = row;
+            }
+            order.swap(sorted);
+        }
+    }
+
+    // Stable merge sort of 'order' by 'columns'. Ranges are sorted in
+    // ... parallel and then merged in pairs, also in parallel.
+    void mergeSort(const QVector<SKeyColumn> &columns, QVector<qint32> &order)
+    {
+        auto less_than = [&] (qint32 r1, qint32 r2)
+        {
+            for(const SKeyColumn &column : columns) {
+                for(const QVector<quint64> &word : column.words) {
+                    if(word.at(r1) != word.at(r2)) {
+                        return word.at(r1) < word.at(r2);
+                    }
+                }
+                if(!column.strings.isEmpty() &&
+                   column.strings.at(r1) != column.strings.at(r2)) {
+                    return column.ascending ?
+                                column.strings.at(r1) < column.strings.at(r2) :
+                                column.strings.at(r2) < column.strings.at(r1);
+                }
+            }
+            return false;
+        };
+
+        qint32 row_count = order.size();
+        qint32 range_size = qMax(row_count / QThread::idealThreadCount() + 1, 4096);
+        QVector<QPair<qint32, qint32>> ranges;
+        for(qint32 i = 0; i < row_count; i += range_size) {
+            ranges.append(qMakePair(i, qMin(i + range_size, row_count)));
+        }
+        qint32 *rows = order.data();
+        QtConcurrent::blockingMap(ranges, [&] (const QPair<qint32, qint32> &range) {
+            std::stable_sort(rows + range.first, rows + range.second, less_than);
+        });
+
+        QVector<qint32> merged(row_count);
+        qint32 *merged_rows = merged.data();
+        for(; range_size < row_count; range_size *= 2) {
+            ranges.clear();
+            for(qint32 i = 0; i < row_count; i += 2 * range_size) {
+                ranges.append(qMakePair(i, qMin(i + 2 * range_size, row_count)));
+            }
+            QtConcurrent::blockingMap(ranges, [&] (const QPair<qint32, qint32> &range) {
+                qint32 middle = qMin(range.first + range_size, range.second);
+                std::merge(rows + range.first, rows + middle,
+                           rows + middle, rows + range.second,
+                           merged_rows + range.first, less_than);
+            });
+            std::swap(rows, merged_rows);
+        }
+        if(rows != order.data()) {
+            order.swap(merged);
+        }
+    }
+}
 
 
 //------------------------------------------------------------------------------
@@ -30,15 +307,17 @@ qint32 CTableData::colCount() const
     return 0;
 }
 
-void CTableData::addHeader(QString attr)
+void CTableData::addHeader(QString attr, EFormat format/* = EFormat::raw*/)
 {
     m_header.append(attr);
+    m_formats.append(format);
 }
 
 void CTableData::addHeader(const QList<QString> &attrs)
 {
     for(const QString &attr : attrs) {
         m_header.append(attr);
+        m_formats.append(EFormat::raw);
     }
 }
 
@@ -58,6 +337,30 @@ qint32 CTableData::headerSize() const
     return m_header.size();
 }
 
+CTableData::EFormat CTableData::headerFormat(qint32 col) const
+{
+    return m_formats.value(col, EFormat::raw);
+}
+
+QString CTableData::formatValue(qint32 col, const QVariant &value) const
+{
+    switch(headerFormat(col)) {
+    case EFormat::datetime: {
+        QString date, time;
+        formatDateTime(value.toLongLong(), date, time);
+        return date + ' ' + time;
+    }
+    case EFormat::ipv4:
+        return formatAddress(value.toUInt());
+    case EFormat::octet:
+        return formatOctet(value.toUInt());
+    case EFormat::tcp_flags:
+        return formatTcpFlags(value.toUInt());
+    default:
+        return value.toString();
+    }
+}
+
 QList<QVariant> &CTableData::newRow()
 {
     m_table.append(QList<QVariant>());
@@ -68,6 +371,11 @@ QList<QVariant> &CTableData::newRow()
     return m_table.last();
 }
 
+void CTableData::appendRows(const QList<QList<QVariant>> &rows)
+{
+    m_table.append(rows);
+}
+
 const QList<QVariant> &CTableData::getRow(int i_row) const
 {
     return m_table.at(i_row);
@@ -85,43 +393,191 @@ const QList<QList<QVariant>> &CTableData::table() const
     return m_table;
 }
 
+void CTableData::sort(const QList<SSortKey> &keys)
+{
+    if(keys.isEmpty() || m_table.size() < 2) {
+        return;
+    }
+
+    // Sort the row indices and then move the rows (only their references
+    // ... are copied).
+    QVector<qint32> order = sortOrder(keys);
+    QList<QList<QVariant>> sorted;
+    sorted.reserve(order.size());
+    for(qint32 row : order) {
+        sorted.append(m_table.at(row));
+    }
+    m_table.swap(sorted);
+}
+
 void CTableData::sort(qint32 field1)
 {
-    // The lambda sort function
-    auto f_less_than = [&] (const QList<QVariant> &r1, const QList<QVariant> &r2)
-    {
-        if(r1.at(field1) < r2.at(field1)) {
-            return true;
-        } else {
-            return false;
-        }
-    };
-    std::sort(m_table.begin(), m_table.end(), f_less_than);
+    sort(QList<SSortKey>() << SSortKey(field1));
 }
 
 void CTableData::sort(qint32 field1, qint32 field2)
 {
-    // Lambda sort function.
-    auto f_less_than = [&] (const QList<QVariant> &r1, const QList<QVariant> &r2)
-    {
-        if(r1.at(field1).toString() < r2.at(field1).toString()) {
-            return true;
+    sort(QList<SSortKey>() << SSortKey(field1) << SSortKey(field2));
+}
+
+bool CTableData::parseSortKeys(const QString &spec, QList<SSortKey> &keys) const
+{
+    keys.clear();
+    for(const QString &key : spec.split(',', QString::SkipEmptyParts)) {
+        QStringList words = key.simplified().split(' ');
+        bool ascending = true;
+        if(words.size() == 2 && (words.last() == "asc" || words.last() == "desc")) {
+            ascending = words.takeLast() == "asc";
         }
-        else if(r1.at(field1).toString() == r2.at(field1).toString()) {
-            if(r1.at(field2).toString() < r2.at(field2).toString()) {
-                return true;
-            }
-            else {
-                return false;
-            }
+        if(words.size() != 1) {
+            return false;
+        }
+
+        // Header names go first, then column indices.
+        bool ok = true;
+        qint32 field = findHeader(words.first());
+        if(field < 0) {
+            field = words.first().toInt(&ok);
         }
-        else {
+        if(!ok || field < 0 || (headerSize() > 0 && field >= headerSize())) {
             return false;
         }
-    };
-    std::sort(m_table.begin(), m_table.end(), f_less_than);
+        keys.append(SSortKey(field, ascending));
+    }
+
+    return !keys.isEmpty();
+}
+
+bool CTableData::lessThan(const QList<QVariant> &row1, const QList<QVariant> &row2,
+                          const QList<SSortKey> &keys)
+{
+    for(const SSortKey &key : keys) {
+        const QVariant value1 = row1.value(key.field);
+        const QVariant value2 = row2.value(key.field);
+        EKeyType type1 = keyType(value1);
+        EKeyType type2 = keyType(value2);
+
+        qint32 compare = keyRank(type1) - keyRank(type2);
+        if(compare == 0 && type1 == EKeyType::text) {
+            compare = value1.toString().compare(value2.toString());
+        }
+        else if(compare == 0 && type1 != EKeyType::null) {
+            compare = compareNumbers(value1, type1, value2, type2);
+        }
+
+        if(compare != 0) {
+            return key.ascending ? compare < 0 : compare > 0;
+        }
+    }
+
+    return false;
+}
+
+void CTableData::formatDateTime(qint64 seconds, QString &date, QString &time)
+{
+    // Split the seconds into days and the time of the day.
+    qint64 days = seconds / 86400;
+    qint64 day_seconds = seconds % 86400;
+    if(day_seconds < 0) {
+        day_seconds += 86400;
+        --days;
+    }
+
+    // Convert the days since 1970-01-01 to a civil date (proleptic
+    // ... Gregorian calendar), counting eras of 400 years from 0000-03-01.
+    days += 719468;
+    qint64 era = (days >= 0 ? days : days - 146096) / 146097;
+    qint64 day_of_era = days - era * 146097;
+    qint64 year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+                          day_of_era / 146096) / 365;
+    qint64 day_of_year = day_of_era -
+            (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    qint64 month_index = (5 * day_of_year + 2) / 153;
+    qint32 day = day_of_year - (153 * month_index + 2) / 5 + 1;
+    qint32 month = month_index < 10 ? month_index + 3 : month_index - 9;
+    qint64 year = year_of_era + era * 400 + (month <= 2);
+
+    // MM/dd/yyyy hh:mm:ss
+    char buffer[24];
+    qsnprintf(buffer, sizeof(buffer), "%02d/%02d/%04lld", month, day,
+              static_cast<long long>(year));
+    date = QString::fromLatin1(buffer);
+    qsnprintf(buffer, sizeof(buffer), "%02d:%02d:%02d",
+              static_cast<qint32>(day_seconds / 3600),
+              static_cast<qint32>(day_seconds / 60 % 60),
+              static_cast<qint32>(day_seconds % 60));
+    time = QString::fromLatin1(buffer);
+}
+
+QString CTableData::formatAddress(quint32 address)
+{
+    char buffer[16];
+    qsnprintf(buffer, sizeof(buffer), "%u.%u.%u.%u",
+              (address >> 24) & 0xFF, (address >> 16) & 0xFF,
+              (address >> 8) & 0xFF, address & 0xFF);
+
+    return QString::fromLatin1(buffer);
+}
+
+QString CTableData::formatOctet(quint32 octet)
+{
+    char buffer[4];
+    qsnprintf(buffer, sizeof(buffer), "%03u", octet & 0xFF);
+
+    return QString::fromLatin1(buffer);
+}
+
+QString CTableData::formatTcpFlags(quint8 flags)
+{
+    QString str(".");
+    if(flags & 128) str.append('1');
+    if(flags & 64) str.append('0');
+    if(flags & 32) str.append('U');
+    if(flags & 16) str.append('A');
+    if(flags & 8) str.append('P');
+    if(flags & 4) str.append('R');
+    if(flags & 2) str.append('S');
+    if(flags & 1) str.append('F');
+
+    return str;
 }
 
 
 //------------------------------------------------------------------------------
 // Private Functions
+
+QVector<qint32> CTableData::sortOrder(const QList<SSortKey> &keys) const
+{
+    qint32 row_count = m_table.size();
+
+    // Extract the keys of every row once.
+    QVector<SKeyColumn> columns;
+    for(const SSortKey &key : keys) {
+        columns.append(keyColumn(m_table, key));
+    }
+
+    QVector<qint32> order(row_count);
+    for(qint32 i = 0; i < row_count; ++i) {
+        order[i] = i;
+    }
+
+    bool numbers = std::all_of(columns.begin(), columns.end(),
+                               [] (const SKeyColumn &column) {
+        return column.strings.isEmpty();
+    });
+    if(numbers) {
+        // Sort by the last word of the last key first, the passes are
+        // ... stable.
+        for(qint32 i = columns.size() - 1; i >= 0; --i) {
+            const QVector<QVector<quint64>> &words = columns.at(i).words;
+            for(qint32 j = words.size() - 1; j >= 0; --j) {
+                radixSort(words.at(j), order);
+            }
+        }
+    }
+    else {
+        mergeSort(columns, order);
+    }
+
+    return order;
+}
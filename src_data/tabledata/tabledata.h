@@ -4,16 +4,31 @@
 #include "data/data.h"
 #include <QList>
 #include <QVariant>
+#include <QVector>
 
 
 class CTableData: public CData
 {
+  public:
+    // How the values of a column are written out. Columns with a format
+    // ... other than 'raw' hold numbers that are only formatted when needed.
+    enum class EFormat {raw, datetime, ipv4, octet, tcp_flags};
+    // A column to sort the rows by.
+    struct SSortKey {
+        qint32 field;
+        bool ascending;
+        SSortKey(qint32 p_field, bool p_ascending = true)
+            : field(p_field)
+            , ascending(p_ascending) {}
+    };
 
   private:
     // Storage of the actual 'table data'.
     QList<QList<QVariant>> m_table;
     // String representations of the table columns.
     QList<QString> m_header;
+    // The format of each column.
+    QList<EFormat> m_formats;
 
   public:
     explicit CTableData();
@@ -22,18 +37,45 @@ class CTableData: public CData
     void reserveRows(qint32 size) { m_table.reserve(size); }
     qint32 rowCount() const { return m_table.size(); }
     qint32 colCount() const;
-    void addHeader(QString attr);
+    void addHeader(QString attr, EFormat format = EFormat::raw);
     void addHeader(const QList<QString> &attrs);
     qint32 findHeader(QString attr) const;
     const QList<QString> &header() const;
     qint32 headerSize() const;
+    EFormat headerFormat(qint32 col) const;
+    // The text of 'value' following the format of column 'col'.
+    QString formatValue(qint32 col, const QVariant &value) const;
     QList<QVariant> &newRow();
+    // Append rows built elsewhere (e.g., by several threads).
+    void appendRows(const QList<QList<QVariant>> &rows);
     const QList<QVariant> &getRow(int irow) const;
     virtual CDataPointer clone() const;
     const QList<QList<QVariant>> &table() const;
 
+    // Sort the rows by the first key, then by the second one and so on. The
+    // ... sort is stable. Within a column, nulls go first, then the numbers
+    // ... by value and then the text.
+    void sort(const QList<SSortKey> &keys);
     void sort(qint32 field1);
     void sort(qint32 field1, qint32 field2);
+    // Parse a comma separated list of columns (header names or indices),
+    // ... each optionally followed by "asc" or "desc", e.g., "DA, DUR desc".
+    bool parseSortKeys(const QString &spec, QList<SSortKey> &keys) const;
+    // Does 'row1' go before 'row2'? Rows are compared in the same order
+    // ... sort() uses, so sorted tables can be merged with it.
+    static bool lessThan(const QList<QVariant> &row1, const QList<QVariant> &row2,
+                         const QList<SSortKey> &keys);
+
+    // Format the seconds since the epoch as "MM/dd/yyyy" and "hh:mm:ss".
+    static void formatDateTime(qint64 seconds, QString &date, QString &time);
+    static QString formatAddress(quint32 address);
+    // An octet padded with 0s to three digits.
+    static QString formatOctet(quint32 octet);
+    static QString formatTcpFlags(quint8 flags);
+
+  private:
+    // The order of the rows sorted by 'keys'.
+    QVector<qint32> sortOrder(const QList<SSortKey> &keys) const;
 };
 
 Q_DECLARE_METATYPE(CTableData*)
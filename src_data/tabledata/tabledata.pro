@@ -1,4 +1,5 @@
 QT += core
+QT += concurrent
 QT -= gui
 
 TARGET = tabledata
@@ -28,8 +29,10 @@ QMAKE_CLEAN += $$DESTDIR/*$$TARGET*
 
 HEADERS += \
     tabledata.h \
+    tablefile.h \
     interface.h
 
 SOURCES += \
     tabledata.cpp \
+    tablefile.cpp \
     interface.cpp
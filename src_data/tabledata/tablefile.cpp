@@ -0,0 +1,513 @@
+#include "tablefile.h"
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QStringList>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <climits>
+#include <cstring>
+
+namespace {
+    const quint32 MAGIC = 0x414e5442; // "ANTB"
+    const quint32 VERSION = 1;
+    // The magic and version at the beginning of the file and the size of
+    // ... the footer and magic at the end.
+    const qint32 HEAD_SIZE = 8;
+    const qint32 TRAILER_SIZE = 8;
+    const qint32 GROUP_ROWS = 65536;
+    // Fixed so that files do not depend on the version of Qt.
+    const qint32 STREAM_VERSION = QDataStream::Qt_5_0;
+
+    // How the values of a column are stored.
+    enum class EKind {variant, boolean, int32, uint32, int64, uint64, real,
+                      string};
+
+    struct SPage {
+        qint64 offset;
+        qint32 size;
+        bool compressed;
+    };
+
+    EKind valueKind(const QVariant &value)
+    {
+        switch(static_cast<QMetaType::Type>(value.userType())) {
+        case QMetaType::Bool:
+            return EKind::boolean;
+        case QMetaType::Int:
+            return EKind::int32;
+        case QMetaType::UInt:
+            return EKind::uint32;
+        case QMetaType::LongLong:
+            return EKind::int64;
+        case QMetaType::ULongLong:
+            return EKind::uint64;
+        case QMetaType::Double:
+            return EKind::real;
+        case QMetaType::QString:
+            return EKind::string;
+        default:
+            return EKind::variant;
+        }
+    }
+
+    // Columns whose values do not share a type are stored as QVariants.
+    EKind columnKind(const QList<QList<QVariant>> &rows, qint32 col)
+    {
+        if(rows.isEmpty()) {
+            return EKind::variant;
+        }
+
+        EKind kind = valueKind(rows.first().value(col));
+        for(const QList<QVariant> &row : rows) {
+            if(valueKind(row.value(col)) != kind) {
+                return EKind::variant;
+            }
+        }
+
+        return kind;
+    }
+
+    // Store the values of a column as an array of little endian numbers.
+    template<typename T, typename F>
+    QByteArray encodeNumbers(const QList<QList<QVariant>> &rows, qint32 first,
+                             qint32 last, qint32 col, F number)
+    {
+        QByteArray page((last - first) * sizeof(T), 0);
+        uchar *data = reinterpret_cast<uchar *>(page.data());
+        for(qint32 i = first; i < last; ++i, data += sizeof(T)) {
+            qToLittleEndian<T>(number(rows.at(i).at(col)), data);
+        }
+
+        return page;
+    }
+
+    template<typename T, typename F>
+    bool decodeNumbers(const QByteArray &page, QList<QList<QVariant>> &rows,
+                       F value)
+    {
+        if(page.size() != rows.size() * static_cast<qint32>(sizeof(T))) {
+            return false;
+        }
+
+        const uchar *data = reinterpret_cast<const uchar *>(page.constData());
+        for(QList<QVariant> &row : rows) {
+            row.append(value(qFromLittleEndian<T>(data)));
+            data += sizeof(T);
+        }
+
+        return true;
+    }
+
+    quint64 realBits(double real)
+    {
+        quint64 bits;
+        std::memcpy(&bits, &real, sizeof(bits));
+        return bits;
+    }
+
+    double bitsReal(quint64 bits)
+    {
+        double real;
+        std::memcpy(&real, &bits, sizeof(real));
+        return real;
+    }
+
+    // Store the strings of a column as a dictionary followed by the index
+    // ... of every value in it, using as few bytes per index as possible.
+    QByteArray encodeStrings(const QList<QList<QVariant>> &rows, qint32 first,
+                             qint32 last, qint32 col)
+    {
+        QHash<QString, quint32> positions;
+        QStringList dictionary;
+        QVector<quint32> indices;
+        indices.reserve(last - first);
+        for(qint32 i = first; i < last; ++i) {
+            QString value = rows.at(i).at(col).toString();
+            auto it = positions.find(value);
+            if(it == positions.end()) {
+                it = positions.insert(value, dictionary.size());
+                dictionary.append(value);
+            }
+            indices.append(it.value());
+        }
+
+        QByteArray page;
+        QDataStream out(&page, QIODevice::WriteOnly);
+        out.setVersion(STREAM_VERSION);
+        out << static_cast<quint32>(dictionary.size());
+        for(const QString &value : dictionary) {
+            out << value;
+        }
+        quint8 width = dictionary.size() <= 0x100 ? 1 :
+                       dictionary.size() <= 0x10000 ? 2 : 4;
+        out << width;
+
+        qint32 position = page.size();
+        page.resize(position + indices.size() * width);
+        uchar *data = reinterpret_cast<uchar *>(page.data()) + position;
+        for(quint32 index : indices) {
+            if(width == 1) {
+                *data = static_cast<quint8>(index);
+            }
+            else if(width == 2) {
+                qToLittleEndian<quint16>(index, data);
+            }
+            else {
+                qToLittleEndian<quint32>(index, data);
+            }
+            data += width;
+        }
+
+        return page;
+    }
+
+    bool decodeStrings(const QByteArray &page, QList<QList<QVariant>> &rows)
+    {
+        QDataStream in(page);
+        in.setVersion(STREAM_VERSION);
+        quint32 size;
+        in >> size;
+        if(in.status() != QDataStream::Ok ||
+           size > static_cast<quint32>(rows.size())) {
+            return false;
+        }
+
+        QVector<QVariant> dictionary(size);
+        for(QVariant &value : dictionary) {
+            QString string;
+            in >> string;
+            value = string;
+        }
+        quint8 width;
+        in >> width;
+        if(in.status() != QDataStream::Ok || (width != 1 && width != 2 && width != 4)) {
+            return false;
+        }
+
+        qint64 position = in.device()->pos();
+        if(page.size() - position != static_cast<qint64>(rows.size()) * width) {
+            return false;
+        }
+        const uchar *data = reinterpret_cast<const uchar *>(page.constData()) + position;
+        for(QList<QVariant> &row : rows) {
+            quint32 index = width == 1 ? *data :
+                            width == 2 ? qFromLittleEndian<quint16>(data) :
+                                         qFromLittleEndian<quint32>(data);
+            if(index >= size) {
+                return false;
+            }
+            row.append(dictionary.at(index));
+            data += width;
+        }
+
+        return true;
+    }
+
+    QByteArray encodePage(const QList<QList<QVariant>> &rows, qint32 first,
+                          qint32 last, qint32 col, EKind kind)
+    {
+        switch(kind) {
+        case EKind::boolean:
+            return encodeNumbers<quint8>(rows, first, last, col,
+                [] (const QVariant &value) { return value.toBool(); });
+        case EKind::int32:
+            return encodeNumbers<qint32>(rows, first, last, col,
+                [] (const QVariant &value) { return value.toInt(); });
+        case EKind::uint32:
+            return encodeNumbers<quint32>(rows, first, last, col,
+                [] (const QVariant &value) { return value.toUInt(); });
+        case EKind::int64:
+            return encodeNumbers<qint64>(rows, first, last, col,
+                [] (const QVariant &value) { return value.toLongLong(); });
+        case EKind::uint64:
+            return encodeNumbers<quint64>(rows, first, last, col,
+                [] (const QVariant &value) { return value.toULongLong(); });
+        case EKind::real:
+            return encodeNumbers<quint64>(rows, first, last, col,
+                [] (const QVariant &value) { return realBits(value.toDouble()); });
+        case EKind::string:
+            return encodeStrings(rows, first, last, col);
+        default: {
+            QByteArray page;
+            QDataStream out(&page, QIODevice::WriteOnly);
+            out.setVersion(STREAM_VERSION);
+            for(qint32 i = first; i < last; ++i) {
+                out << rows.at(i).value(col);
+            }
+            return page;
+        }
+        }
+    }
+
+    bool decodePage(const QByteArray &page, EKind kind,
+                    QList<QList<QVariant>> &rows)
+    {
+        switch(kind) {
+        case EKind::boolean:
+            return decodeNumbers<quint8>(page, rows,
+                [] (quint8 value) { return QVariant(value != 0); });
+        case EKind::int32:
+            return decodeNumbers<qint32>(page, rows,
+                [] (qint32 value) { return QVariant(value); });
+        case EKind::uint32:
+            return decodeNumbers<quint32>(page, rows,
+                [] (quint32 value) { return QVariant(value); });
+        case EKind::int64:
+            return decodeNumbers<qint64>(page, rows,
+                [] (qint64 value) { return QVariant(value); });
+        case EKind::uint64:
+            return decodeNumbers<quint64>(page, rows,
+                [] (quint64 value) { return QVariant(value); });
+        case EKind::real:
+            return decodeNumbers<quint64>(page, rows,
+                [] (quint64 value) { return QVariant(bitsReal(value)); });
+        case EKind::string:
+            return decodeStrings(page, rows);
+        default: {
+            QDataStream in(page);
+            in.setVersion(STREAM_VERSION);
+            for(QList<QVariant> &row : rows) {
+                QVariant value;
+                in >> value;
+                row.append(value);
+            }
+            return in.status() == QDataStream::Ok && in.atEnd();
+        }
+        }
+    }
+
+    void writeUInt32(QFile &file, quint32 value)
+    {
+        uchar data[4];
+        qToLittleEndian<quint32>(value, data);
+        file.write(reinterpret_cast<const char *>(data), sizeof(data));
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+bool CTableFile::save(const CTableData &table, const QString &filename,
+                      bool compress)
+{
+    const QList<QList<QVariant>> &rows = table.table();
+    qint32 row_count = rows.size();
+    qint32 column_count = table.headerSize();
+    for(const QList<QVariant> &row : rows) {
+        column_count = qMax(column_count, row.size());
+    }
+    QVector<EKind> kinds;
+    for(qint32 col = 0; col < column_count; ++col) {
+        kinds.append(columnKind(rows, col));
+    }
+
+    QFile file(filename);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    writeUInt32(file, MAGIC);
+    writeUInt32(file, VERSION);
+
+    // Encode the pages of a few groups at a time in parallel and write them
+    // ... in order.
+    QVector<SPage> pages;
+    qint32 group_count = (row_count + GROUP_ROWS - 1) / GROUP_ROWS;
+    qint32 batch_size = 2 * QThread::idealThreadCount();
+    for(qint32 batch = 0; batch < group_count; batch += batch_size) {
+        QVector<QPair<qint32, qint32>> tasks;
+        for(qint32 group = batch; group < qMin(batch + batch_size, group_count); ++group) {
+            for(qint32 col = 0; col < column_count; ++col) {
+                tasks.append(qMakePair(group, col));
+            }
+        }
+
+        QVector<QByteArray> encoded(tasks.size());
+        QVector<bool> compressed(tasks.size(), false);
+        QByteArray *encoded_pages = encoded.data();
+        bool *compressed_pages = compressed.data();
+        QtConcurrent::blockingMap(tasks, [&] (const QPair<qint32, qint32> &task) {
+            qint32 index = &task - tasks.constData();
+            qint32 first = task.first * GROUP_ROWS;
+            qint32 last = qMin(first + GROUP_ROWS, row_count);
+            QByteArray page = encodePage(rows, first, last, task.second,
+                                         kinds.at(task.second));
+            if(compress) {
+                // Keep the page as it is when compressing does not help.
+                QByteArray small = qCompress(page);
+                if(small.size() < page.size()) {
+                    page = small;
+                    compressed_pages[index] = true;
+                }
+            }
+            encoded_pages[index] = page;
+        });
+
+        for(qint32 i = 0; i < encoded.size(); ++i) {
+            SPage page = {file.pos(), encoded.at(i).size(), compressed.at(i)};
+            pages.append(page);
+            file.write(encoded.at(i));
+        }
+    }
+
+    // The footer describes the columns and where their pages are.
+    QByteArray footer;
+    QDataStream out(&footer, QIODevice::WriteOnly);
+    out.setVersion(STREAM_VERSION);
+    out << static_cast<qint64>(row_count) << GROUP_ROWS << column_count
+        << static_cast<qint32>(table.headerSize());
+    for(qint32 col = 0; col < column_count; ++col) {
+        out << table.header().value(col)
+            << static_cast<quint8>(table.headerFormat(col))
+            << static_cast<quint8>(kinds.at(col));
+    }
+    for(const SPage &page : pages) {
+        out << page.offset << page.size << page.compressed;
+    }
+    file.write(footer);
+    writeUInt32(file, footer.size());
+    writeUInt32(file, MAGIC);
+
+    return file.error() == QFile::NoError;
+}
+
+bool CTableFile::load(const QString &filename, CTableData &table, QString &error)
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly)) {
+        error = "Could not open " + filename;
+        return false;
+    }
+
+    // Map the whole file, pages are decoded straight from it.
+    qint64 size = file.size();
+    const uchar *data = size >= HEAD_SIZE + TRAILER_SIZE ? file.map(0, size) : nullptr;
+    if(data == nullptr ||
+       qFromLittleEndian<quint32>(data) != MAGIC ||
+       qFromLittleEndian<quint32>(data + size - 4) != MAGIC) {
+        error = filename + " is not a table file.";
+        return false;
+    }
+    if(qFromLittleEndian<quint32>(data + 4) != VERSION) {
+        error = filename + " has an unknown version.";
+        return false;
+    }
+
+    qint64 footer_size = qFromLittleEndian<quint32>(data + size - TRAILER_SIZE);
+    qint64 footer_offset = size - TRAILER_SIZE - footer_size;
+    if(footer_offset < HEAD_SIZE) {
+        error = filename + " is truncated.";
+        return false;
+    }
+
+    // Read the footer.
+    QByteArray footer = QByteArray::fromRawData(
+                reinterpret_cast<const char *>(data + footer_offset), footer_size);
+    QDataStream in(footer);
+    in.setVersion(STREAM_VERSION);
+    qint64 row_count;
+    qint32 group_rows, column_count, header_size;
+    in >> row_count >> group_rows >> column_count >> header_size;
+    if(in.status() != QDataStream::Ok || row_count < 0 || row_count > INT_MAX ||
+       group_rows <= 0 || column_count < 0 || header_size < 0 ||
+       header_size > column_count) {
+        error = filename + " has a corrupt footer.";
+        return false;
+    }
+
+    QStringList names;
+    QList<CTableData::EFormat> formats;
+    QVector<EKind> kinds;
+    for(qint32 col = 0; col < column_count; ++col) {
+        QString name;
+        quint8 format, kind;
+        in >> name >> format >> kind;
+        if(format > static_cast<quint8>(CTableData::EFormat::tcp_flags) ||
+           kind > static_cast<quint8>(EKind::string)) {
+            error = filename + " has a corrupt footer.";
+            return false;
+        }
+        names.append(name);
+        formats.append(static_cast<CTableData::EFormat>(format));
+        kinds.append(static_cast<EKind>(kind));
+    }
+
+    // Every page takes 13 bytes of the footer.
+    qint32 group_count = (row_count + group_rows - 1) / group_rows;
+    qint64 page_count = static_cast<qint64>(group_count) * column_count;
+    if(page_count * 13 > footer_size) {
+        error = filename + " has a corrupt footer.";
+        return false;
+    }
+    QVector<SPage> pages(page_count);
+    for(SPage &page : pages) {
+        in >> page.offset >> page.size >> page.compressed;
+        if(page.offset < HEAD_SIZE || page.size < 0 ||
+           page.offset + page.size > footer_offset) {
+            in.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+    }
+    if(in.status() != QDataStream::Ok) {
+        error = filename + " has a corrupt footer.";
+        return false;
+    }
+
+    if(table.headerSize() == 0) {
+        for(qint32 col = 0; col < header_size; ++col) {
+            table.addHeader(names.at(col), formats.at(col));
+        }
+    }
+    table.reserveRows(table.rowCount() + row_count);
+
+    // Decode a few groups at a time in parallel and add their rows in order.
+    QAtomicInt valid(1);
+    qint32 batch_size = 2 * QThread::idealThreadCount();
+    for(qint32 batch = 0; batch < group_count && valid.load(); batch += batch_size) {
+        QVector<qint32> groups;
+        for(qint32 group = batch; group < qMin(batch + batch_size, group_count); ++group) {
+            groups.append(group);
+        }
+
+        QVector<QList<QList<QVariant>>> rows(groups.size());
+        QList<QList<QVariant>> *batch_rows = rows.data();
+        QtConcurrent::blockingMap(groups, [&] (const qint32 &group) {
+            QList<QList<QVariant>> &block = batch_rows[group - batch];
+            qint32 first = group * group_rows;
+            qint32 count = qMin<qint64>(group_rows, row_count - first);
+            for(qint32 i = 0; i < count; ++i) {
+                block.append(QList<QVariant>());
+                block.last().reserve(column_count);
+            }
+
+            for(qint32 col = 0; col < column_count && valid.load(); ++col) {
+                const SPage &page = pages.at(group * column_count + col);
+                const char *bytes = reinterpret_cast<const char *>(data + page.offset);
+                QByteArray contents = page.compressed ?
+                            qUncompress(reinterpret_cast<const uchar *>(bytes), page.size) :
+                            QByteArray::fromRawData(bytes, page.size);
+                if(!decodePage(contents, kinds.at(col), block)) {
+                    valid.store(0);
+                }
+            }
+        });
+
+        if(valid.load()) {
+            for(const QList<QList<QVariant>> &block : rows) {
+                table.appendRows(block);
+            }
+        }
+    }
+
+    if(!valid.load()) {
+        error = filename + " has corrupt pages.";
+        return false;
+    }
+
+    return true;
+}
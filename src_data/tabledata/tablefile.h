@@ -0,0 +1,25 @@
+#ifndef TABLEFILE_H
+#define TABLEFILE_H
+
+#include "tabledata.h"
+#include <QString>
+
+
+// Binary files of tables stored by columns. The rows are split into groups
+// ... and every column of a group is stored in its own page: numbers as
+// ... arrays, strings as a dictionary plus indices and any other value as a
+// ... serialized QVariant. Pages may be compressed with qCompress(). A
+// ... footer at the end of the file has the header, the column types and
+// ... the position of every page, so files are read by mapping them.
+class CTableFile
+{
+  public:
+    // Write 'table' to 'filename'. Return false if it could not be written.
+    static bool save(const CTableData &table, const QString &filename,
+                     bool compress);
+    // Append the rows of 'filename' to 'table', which takes the header of
+    // ... the file if it has none. Set 'error' if the file cannot be read.
+    static bool load(const QString &filename, CTableData &table, QString &error);
+};
+
+#endif // TABLEFILE_H
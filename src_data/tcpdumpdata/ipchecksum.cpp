@@ -0,0 +1,146 @@
+#include "ipchecksum.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__SSE2__))
+#define IPCHECKSUM_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    typedef void (*BatchKernel)(const uchar *, const qint32 *, const quint8 *,
+                                qint32, quint8 *);
+
+    inline bool folded(quint32 sum)
+    {
+        return (sum >> 16) + (sum & 0xffff) == 0xffff;
+    }
+
+#ifdef IPCHECKSUM_X86
+    // Add the big endian words of a header using 16 byte registers.
+    bool sse2Valid(const uchar *header, quint32 length)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sum = zero;
+
+        while(length > 0) {
+            __m128i words;
+            if(length >= 16) {
+                words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(header));
+                header += 16;
+                length -= 16;
+            }
+            else {
+                // Copy the tail so that no byte after the header is read.
+                qint32 tail[4] = {0, 0, 0, 0};
+                std::memcpy(tail, header, length);
+                words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tail));
+                length = 0;
+            }
+            // Swap to host order and widen to 32 bits before adding.
+            words = _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+            sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(words, zero));
+            sum = _mm_add_epi32(sum, _mm_unpackhi_epi16(words, zero));
+        }
+
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        return folded(static_cast<quint32>(_mm_cvtsi128_si32(sum)));
+    }
+
+    void sse2Batch(const uchar *base, const qint32 *offsets,
+                   const quint8 *lengths, qint32 count, quint8 *valid)
+    {
+        for(qint32 i = 0; i < count; ++i) {
+            valid[i] = sse2Valid(base + offsets[i], lengths[i]);
+        }
+    }
+
+    // Check eight headers without options (20 bytes) at a time by gathering
+    // ... the same 4 bytes of every header into one register.
+    __attribute__((target("avx2")))
+    void avx2Batch(const uchar *base, const qint32 *offsets,
+                   const quint8 *lengths, qint32 count, quint8 *valid)
+    {
+        const __m256i swap = _mm256_setr_epi8(
+                    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        const __m256i low = _mm256_set1_epi32(0xffff);
+        const int *ints = reinterpret_cast<const int *>(base);
+
+        qint32 i = 0;
+        for(; i + 8 <= count; i += 8) {
+            quint64 lengths8;
+            std::memcpy(&lengths8, lengths + i, 8);
+            if(lengths8 != Q_UINT64_C(0x1414141414141414)) {
+                // Some header has options.
+                sse2Batch(base, offsets + i, lengths + i, 8, valid + i);
+                continue;
+            }
+
+            __m256i index = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i *>(offsets + i));
+            __m256i sum = _mm256_setzero_si256();
+            for(qint32 word = 0; word < 20; word += 4) {
+                __m256i words = _mm256_shuffle_epi8(
+                            _mm256_i32gather_epi32(ints, index, 1), swap);
+                sum = _mm256_add_epi32(sum, _mm256_and_si256(words, low));
+                sum = _mm256_add_epi32(sum, _mm256_srli_epi32(words, 16));
+                index = _mm256_add_epi32(index, _mm256_set1_epi32(4));
+            }
+            sum = _mm256_add_epi32(_mm256_srli_epi32(sum, 16),
+                                   _mm256_and_si256(sum, low));
+            qint32 mask = _mm256_movemask_ps(_mm256_castsi256_ps(
+                    _mm256_cmpeq_epi32(sum, low)));
+            for(qint32 lane = 0; lane < 8; ++lane) {
+                valid[i + lane] = (mask >> lane) & 1;
+            }
+        }
+
+        sse2Batch(base, offsets + i, lengths + i, count - i, valid + i);
+    }
+#else
+    void scalarBatch(const uchar *base, const qint32 *offsets,
+                     const quint8 *lengths, qint32 count, quint8 *valid)
+    {
+        for(qint32 i = 0; i < count; ++i) {
+            valid[i] = CIpChecksum::valid(base + offsets[i], lengths[i]);
+        }
+    }
+#endif
+
+    BatchKernel selectKernel()
+    {
+#ifdef IPCHECKSUM_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) {
+            return avx2Batch;
+        }
+        return sse2Batch;
+#else
+        return scalarBatch;
+#endif
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+bool CIpChecksum::valid(const uchar *header, quint32 length)
+{
+    quint32 t = 0;
+    for(quint32 i = 0; i + 1 < length; i += 2) {
+        t += (header[i] << 8) | header[i + 1];
+    }
+
+    return folded(t);
+}
+
+void CIpChecksum::valid(const uchar *base, const qint32 *offsets,
+                        const quint8 *lengths, qint32 count, quint8 *valid)
+{
+    // Choose the kernel once, the first time it is needed.
+    static const BatchKernel kernel = selectKernel();
+    kernel(base, offsets, lengths, count, valid);
+}
@@ -0,0 +1,22 @@
+#ifndef IPCHECKSUM_H
+#define IPCHECKSUM_H
+
+#include <QtGlobal>
+
+
+// Validation of IPv4 header checksums. The words of a header are added and
+// ... the carry is folded once; the checksum is correct if the result is
+// ... 0xffff. The batch version picks a SSE2 or AVX2 kernel at run time.
+class CIpChecksum
+{
+  public:
+    // Is the checksum of the header at 'header' with 'length' bytes correct?
+    static bool valid(const uchar *header, quint32 length);
+    // Check 'count' headers found at 'offsets' from 'base'. Header 'i' has
+    // ... 'lengths[i]' bytes (a multiple of 4) and 'valid[i]' is set to 1
+    // ... if its checksum is correct, 0 otherwise.
+    static void valid(const uchar *base, const qint32 *offsets,
+                      const quint8 *lengths, qint32 count, quint8 *valid);
+};
+
+#endif // IPCHECKSUM_H
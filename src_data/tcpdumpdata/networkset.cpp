@@ -0,0 +1,138 @@
+#include "networkset.h"
+#include <QStringList>
+#include <algorithm>
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CIpv4Set::CIpv4Set()
+    : m_level16(1 << 16, EMPTY)
+    , m_level24()
+    , m_level32()
+{
+
+}
+
+CPortSet::CPortSet()
+    : m_bits(1024, 0)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+void CIpv4Set::add(quint32 address, quint8 bits)
+{
+    bits = qMin(bits, static_cast<quint8>(32));
+    quint32 network = bits == 0 ? 0 : address & (0xffffffff << (32 - bits));
+
+    // Expand the prefix to all the entries of the level it ends in.
+    if(bits <= 16) {
+        auto first = m_level16.begin() + (network >> 16);
+        std::fill(first, first + (1 << (16 - bits)), static_cast<quint32>(FULL));
+        return;
+    }
+
+    qint32 table = child(m_level16[network >> 16], m_level24);
+    if(table < 0) {
+        return;
+    }
+    qint32 index = table * STRIDE + ((network >> 8) & 0xff);
+    if(bits <= 24) {
+        auto first = m_level24.begin() + index;
+        std::fill(first, first + (1 << (24 - bits)), static_cast<quint32>(FULL));
+        return;
+    }
+
+    table = child(m_level24[index], m_level32);
+    if(table < 0) {
+        return;
+    }
+    auto first = m_level32.begin() + table * STRIDE + (network & 0xff);
+    std::fill(first, first + (1 << (32 - bits)), static_cast<quint8>(FULL));
+}
+
+bool CIpv4Set::add(const QString &networks)
+{
+    for(const QString &network : networks.split(',', QString::SkipEmptyParts)) {
+        QStringList parts = network.trimmed().split('/');
+        quint32 address;
+        quint32 bits = 32;
+        bool ok = parts.size() <= 2 && parseAddress(parts.at(0), address);
+        if(ok && parts.size() == 2) {
+            bits = parts.at(1).toUInt(&ok);
+            ok = ok && bits <= 32;
+        }
+        if(!ok) {
+            return false;
+        }
+        add(address, bits);
+    }
+
+    return true;
+}
+
+bool CIpv4Set::parseAddress(const QString &text, quint32 &address)
+{
+    QStringList octets = text.split('.');
+    if(octets.size() != 4) {
+        return false;
+    }
+
+    address = 0;
+    for(const QString &octet : octets) {
+        bool ok;
+        quint32 value = octet.toUInt(&ok);
+        if(!ok || value > 255) {
+            return false;
+        }
+        address = (address << 8) | value;
+    }
+
+    return true;
+}
+
+void CPortSet::add(quint16 first, quint16 last)
+{
+    for(quint32 port = first; port <= last; ++port) {
+        m_bits[port >> 6] |= Q_UINT64_C(1) << (port & 63);
+    }
+}
+
+bool CPortSet::add(const QString &ports)
+{
+    for(const QString &range : ports.split(',', QString::SkipEmptyParts)) {
+        QStringList parts = range.trimmed().split('-');
+        bool ok_first, ok_last = true;
+        quint32 first = parts.at(0).toUInt(&ok_first);
+        quint32 last = parts.size() == 2 ? parts.at(1).toUInt(&ok_last) : first;
+        if(parts.size() > 2 || !ok_first || !ok_last ||
+           first > 65535 || last > 65535) {
+            return false;
+        }
+        add(first, last);
+    }
+
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+// Private Functions
+
+template<typename T>
+qint32 CIpv4Set::child(quint32 &entry, QVector<T> &tables)
+{
+    if(entry == FULL) {
+        return -1;
+    }
+    if(entry == EMPTY) {
+        entry = tables.size() / STRIDE + CHILD;
+        tables.resize(tables.size() + STRIDE);
+    }
+
+    return entry - CHILD;
+}
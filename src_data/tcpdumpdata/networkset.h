@@ -0,0 +1,83 @@
+#ifndef NETWORKSET_H
+#define NETWORKSET_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+
+
+// A set of IPv4 networks stored as a multibit trie with strides of 16, 8 and
+// ... 8 bits. Prefixes are expanded to the stride boundaries, so a lookup
+// ... reads at most three table entries.
+class CIpv4Set
+{
+  private:
+    // Entries of the tables: not in the set, in the set or the index of the
+    // ... next level table plus CHILD.
+    enum EEntry {EMPTY = 0, FULL = 1, CHILD = 2};
+    static const qint32 STRIDE = 256;
+
+    QVector<quint32> m_level16;
+    QVector<quint32> m_level24;
+    QVector<quint8> m_level32;
+
+  public:
+    explicit CIpv4Set();
+    // Add the network 'address'/'bits' to the set.
+    void add(quint32 address, quint8 bits);
+    // Add a comma separated list of networks in CIDR notation, e.g.,
+    // ... "10.0.0.0/8,192.168.1.1". Return false on a malformed network.
+    bool add(const QString &networks);
+    // Is 'address' inside any of the networks?
+    inline bool contains(quint32 address) const;
+    // Parse an IPv4 address in dotted notation.
+    static bool parseAddress(const QString &text, quint32 &address);
+
+  private:
+    // Get the table below 'entry', creating it if needed. Return -1 if the
+    // ... entry is already covered by a shorter prefix.
+    template<typename T>
+    static qint32 child(quint32 &entry, QVector<T> &tables);
+};
+
+
+// A set of TCP/UDP ports stored as a bitmap.
+class CPortSet
+{
+  private:
+    QVector<quint64> m_bits;
+
+  public:
+    explicit CPortSet();
+    // Add the ports from 'first' to 'last' (both included).
+    void add(quint16 first, quint16 last);
+    // Add a comma separated list of ports and port ranges, e.g.,
+    // ... "22,80,8000-8080". Return false on a malformed entry.
+    bool add(const QString &ports);
+    inline bool contains(quint16 port) const;
+};
+
+
+// Inline functions
+
+bool CIpv4Set::contains(quint32 address) const
+{
+    quint32 entry = m_level16[address >> 16];
+    if(entry < CHILD) {
+        return entry == FULL;
+    }
+
+    entry = m_level24[(entry - CHILD) * STRIDE + ((address >> 8) & 0xff)];
+    if(entry < CHILD) {
+        return entry == FULL;
+    }
+
+    return m_level32[(entry - CHILD) * STRIDE + (address & 0xff)] == FULL;
+}
+
+bool CPortSet::contains(quint16 port) const
+{
+    return (m_bits[port >> 6] >> (port & 63)) & 1;
+}
+
+#endif // NETWORKSET_H
@@ -0,0 +1,358 @@
+#include "packetfilter.h"
+#include "ipchecksum.h"
+
+namespace {
+    // Offsets inside an ethernet frame carrying IPv4.
+    const quint32 IP_OFFSET = 14;
+
+    inline quint16 read2(const uchar *bytes)
+    {
+        return (bytes[0] << 8) | bytes[1];
+    }
+
+    inline quint32 read4(const uchar *bytes)
+    {
+        return (static_cast<quint32>(read2(bytes)) << 16) | read2(bytes + 2);
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CPacketFilter::CPacketFilter()
+    : m_nodes()
+    , m_network_sets()
+    , m_port_sets()
+    , m_root(-1)
+    , m_error()
+    , m_tokens()
+    , m_pos(0)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+bool CPacketFilter::compile(const QString &expression)
+{
+    m_nodes.clear();
+    m_network_sets.clear();
+    m_port_sets.clear();
+    m_root = -1;
+    m_error.clear();
+
+    // Split the expression into words and parentheses.
+    QString spaced = expression;
+    spaced.replace("(", " ( ").replace(")", " ) ");
+    m_tokens = spaced.simplified().split(' ', QString::SkipEmptyParts);
+    m_pos = 0;
+
+    if(m_tokens.isEmpty()) {
+        return true;
+    }
+
+    m_root = parseExpression();
+    if(m_root >= 0 && m_pos < m_tokens.size()) {
+        error("Unexpected '" + m_tokens.at(m_pos) + "'.");
+        m_root = -1;
+    }
+    m_tokens.clear();
+
+    if(m_root < 0) {
+        m_nodes.clear();
+        m_network_sets.clear();
+        m_port_sets.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool CPacketFilter::match(const uchar *frame, quint32 length) const
+{
+    if(m_nodes.isEmpty()) {
+        return true;
+    }
+
+    bool valid_ip = true;
+    if(length > 34 && read2(frame + 12) == 0x800 &&
+       (frame[IP_OFFSET] & 0xf0) == 0x40) {
+        quint32 header_length = (frame[IP_OFFSET] & 15) * 4;
+        valid_ip = IP_OFFSET + header_length <= length &&
+                CIpChecksum::valid(frame + IP_OFFSET, header_length);
+    }
+
+    return match(frame, length, valid_ip);
+}
+
+bool CPacketFilter::match(const uchar *frame, quint32 length,
+                          bool valid_ip) const
+{
+    if(m_nodes.isEmpty()) {
+        return true;
+    }
+
+    SFields fields = {false, 0, 0, 0, 0, 0};
+
+    // Only IPv4 over ethernet is understood (as in CTcpDumpData).
+    if(length > 34 && read2(frame + 12) == 0x800 &&
+       (frame[IP_OFFSET] & 0xf0) == 0x40) {
+        const uchar *ip = frame + IP_OFFSET;
+        quint32 header_length = (ip[0] & 15) * 4;
+        fields.ip = true;
+        fields.src = read4(ip + 12);
+        fields.dst = read4(ip + 16);
+
+        // The protocol layer is only parsed for valid and unfragmented
+        // ... packets.
+        bool fragmented = (read2(ip + 6) & 0x1fff) != 0 || (ip[6] >> 5) & 1;
+        if(valid_ip && !fragmented) {
+            fields.protocol = ip[9];
+            quint32 ports = IP_OFFSET + header_length;
+            if((fields.protocol == 6 || fields.protocol == 17) &&
+               ports + 4 <= length) {
+                fields.src_port = read2(frame + ports);
+                fields.dst_port = read2(frame + ports + 2);
+            }
+        }
+    }
+
+    return evaluate(m_root, fields);
+}
+
+
+//------------------------------------------------------------------------------
+// Private Functions
+
+qint32 CPacketFilter::parseExpression()
+{
+    qint32 left = parseTerm();
+    while(left >= 0 && m_pos < m_tokens.size() &&
+          (m_tokens.at(m_pos) == "or" || m_tokens.at(m_pos) == "||")) {
+        ++m_pos;
+        qint32 right = parseTerm();
+        if(right < 0) {
+            return -1;
+        }
+        left = addNode(EOp::disj, left, right);
+    }
+
+    return left;
+}
+
+qint32 CPacketFilter::parseTerm()
+{
+    qint32 left = parseFactor();
+    while(left >= 0 && m_pos < m_tokens.size() &&
+          (m_tokens.at(m_pos) == "and" || m_tokens.at(m_pos) == "&&")) {
+        ++m_pos;
+        qint32 right = parseFactor();
+        if(right < 0) {
+            return -1;
+        }
+        left = addNode(EOp::conj, left, right);
+    }
+
+    return left;
+}
+
+qint32 CPacketFilter::parseFactor()
+{
+    if(m_pos >= m_tokens.size()) {
+        error("Unexpected end of the expression.");
+        return -1;
+    }
+
+    const QString &token = m_tokens.at(m_pos);
+    if(token == "not" || token == "!") {
+        ++m_pos;
+        qint32 operand = parseFactor();
+        return operand < 0 ? -1 : addNode(EOp::neg, operand);
+    }
+    else if(token == "(") {
+        ++m_pos;
+        qint32 node = parseExpression();
+        if(node < 0) {
+            return -1;
+        }
+        if(m_pos >= m_tokens.size() || m_tokens.at(m_pos) != ")") {
+            error("Missing ')'.");
+            return -1;
+        }
+        ++m_pos;
+        return node;
+    }
+
+    return parsePrimitive();
+}
+
+qint32 CPacketFilter::parsePrimitive()
+{
+    QString token = m_tokens.at(m_pos++);
+
+    if(token == "ip") {
+        return addNode(EOp::ip);
+    }
+    else if(token == "tcp") {
+        return addNode(EOp::tcp);
+    }
+    else if(token == "udp") {
+        return addNode(EOp::udp);
+    }
+    else if(token == "icmp") {
+        return addNode(EOp::icmp);
+    }
+
+    // The remaining primitives take an optional direction and a value.
+    quint8 direction = src_or_dst;
+    if(token == "src" || token == "dst") {
+        direction = token == "src" ? src : dst;
+        if(m_pos >= m_tokens.size()) {
+            error("Expected a primitive after '" + token + "'.");
+            return -1;
+        }
+        token = m_tokens.at(m_pos++);
+    }
+    if(token != "host" && token != "net" &&
+       token != "port" && token != "portrange") {
+        error("Unknown primitive '" + token + "'.");
+        return -1;
+    }
+    if(m_pos >= m_tokens.size()) {
+        error("Expected a value after '" + token + "'.");
+        return -1;
+    }
+    QString value = m_tokens.at(m_pos++);
+
+    if(value.contains(',') || (token == "port" && value.contains('-'))) {
+        // A list of networks or ports.
+        bool ok;
+        if(token == "net") {
+            CIpv4Set networks;
+            ok = networks.add(value);
+            m_network_sets.append(networks);
+        }
+        else if(token == "port") {
+            CPortSet ports;
+            ok = ports.add(value);
+            m_port_sets.append(ports);
+        }
+        else {
+            ok = false;
+        }
+        if(!ok) {
+            error("Invalid list '" + value + "'.");
+            return -1;
+        }
+        return token == "net" ?
+                    addNode(EOp::netset, -1, -1, direction, m_network_sets.size() - 1) :
+                    addNode(EOp::portset, -1, -1, direction, m_port_sets.size() - 1);
+    }
+    else if(token == "host" || token == "net") {
+        quint32 address;
+        quint32 bits = 32;
+        QStringList parts = value.split('/');
+        bool ok = parts.size() <= 2 &&
+                  CIpv4Set::parseAddress(parts.at(0), address);
+        if(ok && parts.size() == 2) {
+            bits = parts.at(1).toUInt(&ok);
+            ok = ok && token == "net" && bits <= 32;
+        }
+        if(!ok) {
+            error("Invalid address '" + value + "'.");
+            return -1;
+        }
+        quint32 mask = bits == 0 ? 0 : 0xffffffff << (32 - bits);
+        return addNode(EOp::net, -1, -1, direction, address & mask, mask);
+    }
+
+    // A port or a range of ports.
+    quint32 from, to;
+    QStringList parts = value.split('-');
+    bool ok;
+    if(token == "port") {
+        ok = parts.size() == 1 && parsePort(parts.at(0), from);
+        to = from;
+    }
+    else {
+        ok = parts.size() == 2 && parsePort(parts.at(0), from) &&
+             parsePort(parts.at(1), to);
+    }
+    if(!ok) {
+        error("Invalid port '" + value + "'.");
+        return -1;
+    }
+
+    return addNode(EOp::port, -1, -1, direction, from, to);
+}
+
+qint32 CPacketFilter::addNode(EOp op, qint32 left, qint32 right,
+                              quint8 direction, quint32 low, quint32 high)
+{
+    SNode node = {op, left, right, direction, low, high};
+    m_nodes.append(node);
+
+    return m_nodes.size() - 1;
+}
+
+bool CPacketFilter::parsePort(const QString &text, quint32 &port) const
+{
+    bool ok;
+    port = text.toUInt(&ok);
+
+    return ok && port <= 65535;
+}
+
+bool CPacketFilter::error(const QString &message)
+{
+    if(m_error.isEmpty()) {
+        m_error = message;
+    }
+
+    return false;
+}
+
+bool CPacketFilter::evaluate(qint32 node, const SFields &fields) const
+{
+    const SNode &n = m_nodes.at(node);
+
+    switch(n.op) {
+    case EOp::conj:
+        return evaluate(n.left, fields) && evaluate(n.right, fields);
+    case EOp::disj:
+        return evaluate(n.left, fields) || evaluate(n.right, fields);
+    case EOp::neg:
+        return !evaluate(n.left, fields);
+    case EOp::ip:
+        return fields.ip;
+    case EOp::tcp:
+        return fields.protocol == 6;
+    case EOp::udp:
+        return fields.protocol == 17;
+    case EOp::icmp:
+        return fields.protocol == 1;
+    case EOp::net:
+        return fields.ip &&
+               (((n.direction & src) && (fields.src & n.high) == n.low) ||
+                ((n.direction & dst) && (fields.dst & n.high) == n.low));
+    case EOp::netset:
+        return fields.ip &&
+               (((n.direction & src) && m_network_sets.at(n.low).contains(fields.src)) ||
+                ((n.direction & dst) && m_network_sets.at(n.low).contains(fields.dst)));
+    case EOp::portset:
+        return (fields.protocol == 6 || fields.protocol == 17) &&
+               (((n.direction & src) && m_port_sets.at(n.low).contains(fields.src_port)) ||
+                ((n.direction & dst) && m_port_sets.at(n.low).contains(fields.dst_port)));
+    case EOp::port:
+        return (fields.protocol == 6 || fields.protocol == 17) &&
+               (((n.direction & src) &&
+                 fields.src_port >= n.low && fields.src_port <= n.high) ||
+                ((n.direction & dst) &&
+                 fields.dst_port >= n.low && fields.dst_port <= n.high));
+    }
+
+    return false;
+}
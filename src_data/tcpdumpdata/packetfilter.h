@@ -0,0 +1,84 @@
+#ifndef PACKETFILTER_H
+#define PACKETFILTER_H
+
+#include "networkset.h"
+#include <QtGlobal>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+
+// A filter of captured frames using a subset of the BPF syntax:
+//   expression := term ('or' term)*
+//   term       := factor ('and' factor)*
+//   factor     := 'not' factor | '(' expression ')' | primitive
+//   primitive  := 'ip' | 'tcp' | 'udp' | 'icmp' |
+//                 [src|dst] 'host' ADDRESS | [src|dst] 'net' ADDRESS/BITS |
+//                 [src|dst] 'port' PORT | [src|dst] 'portrange' PORT-PORT
+// The values of 'net' and 'port' can also be comma separated lists (without
+// ... spaces) such as "net 10.0.0.0/8,192.168.0.0/16" or "port 80,8000-8080".
+// ... Such lists are stored as a CIpv4Set or a CPortSet.
+// Frames are evaluated the same way CTcpDumpData decodes them, i.e.,
+// ... protocols and ports are only known for valid, unfragmented IP packets.
+class CPacketFilter
+{
+  private:
+    enum class EOp {conj, disj, neg, ip, tcp, udp, icmp, net, port, netset,
+                    portset};
+    enum EDirection {src = 1, dst = 2, src_or_dst = 3};
+
+    struct SNode {
+        EOp op;
+        // Operands of 'conj', 'disj' and 'neg'.
+        qint32 left, right;
+        // Direction of 'net' and 'port'.
+        quint8 direction;
+        // Network and mask of 'net', range of 'port' or the index of the set
+        // ... of 'netset' and 'portset'.
+        quint32 low, high;
+    };
+
+    // The fields of a frame used by the primitives.
+    struct SFields {
+        bool ip;
+        quint8 protocol;
+        quint32 src, dst;
+        quint16 src_port, dst_port;
+    };
+
+    QVector<SNode> m_nodes;
+    QVector<CIpv4Set> m_network_sets;
+    QVector<CPortSet> m_port_sets;
+    qint32 m_root;
+    QString m_error;
+    // Used while compiling.
+    QStringList m_tokens;
+    qint32 m_pos;
+
+  public:
+    explicit CPacketFilter();
+    // Compile 'expression'. An empty expression accepts every frame. Return
+    // ... false on syntax errors, leaving the filter empty.
+    bool compile(const QString &expression);
+    // The description of the last syntax error.
+    const QString &errorString() const { return m_error; }
+    bool isEmpty() const { return m_nodes.isEmpty(); }
+    // Does the captured (ethernet) frame match the filter?
+    bool match(const uchar *frame, quint32 length) const;
+    // Same as above when the validity of the IP checksum is already known.
+    bool match(const uchar *frame, quint32 length, bool valid_ip) const;
+
+  private:
+    qint32 parseExpression();
+    qint32 parseTerm();
+    qint32 parseFactor();
+    qint32 parsePrimitive();
+    qint32 addNode(EOp op, qint32 left = -1, qint32 right = -1,
+                   quint8 direction = src_or_dst, quint32 low = 0,
+                   quint32 high = 0);
+    bool parsePort(const QString &text, quint32 &port) const;
+    bool error(const QString &message);
+    bool evaluate(qint32 node, const SFields &fields) const;
+};
+
+#endif // PACKETFILTER_H
@@ -1,5 +1,20 @@
 #include "tcpdumpdata.h"
+#include "ipchecksum.h"
 #include <QDebug>
+#include <QAtomicInt>
+#include <QDataStream>
+#include <QFile>
+#include <QPair>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+    // Size of the record header that precedes every packet.
+    const quint32 RECORD_HEADER_SIZE = 16;
+    // Identify the packet index files and their layout.
+    const quint32 INDEX_MAGIC = 0x414e4958;
+    const quint32 INDEX_VERSION = 1;
+}
 
 //------------------------------------------------------------------------------
 // Constructor and Destructor
@@ -9,6 +24,8 @@ CTcpDumpData::CTcpDumpData()
     , m_magic_word(4, static_cast<char>(0))
     , m_little_endian(true)
     , m_packets()
+    , m_filter()
+    , m_filtered_packets(0)
     , m_reporting_node(nullptr)
 {
 
@@ -41,29 +58,61 @@ void CTcpDumpData::nodeReport(qint8 percentage)
 //------------------------------------------------------------------------------
 // Public Functions
 
-bool CTcpDumpData::parse(const QByteArray &blob)
+bool CTcpDumpData::parse(const QByteArray &blob, const QString &index_file)
 {
     quint32 offset = 0;
 
     // Get the magic word and infer the endianess from it.
     offset = parseHeader(blob);
     if(offset > 0) {
-        // Extract as many packets as we can starting from 'offset'.
-        offset = parsePackets(blob, offset);
-        if(offset > 0) {
-            qDebug() << "Parsed" << offset << "total bytes.";
-            return true;
+        QVector<quint32> offsets;
+        quint32 end = 0;
+
+        // Find where each packet starts, either from a previous index or by
+        // ... walking the chain of record headers.
+        bool indexed = !index_file.isEmpty() &&
+                loadIndex(index_file, blob, offsets, end) &&
+                (offsets.isEmpty() ? end : offsets.first()) == offset;
+        if(!indexed || !parsePackets(blob, offsets, end)) {
+            if(indexed) {
+                qWarning() << "The packet index" << index_file
+                           << "does not match the TCP dump.";
+            }
+            offsets.clear();
+            end = indexPackets(blob, offset, offsets);
+            parsePackets(blob, offsets, end);
+            if(!index_file.isEmpty() && !saveIndex(index_file, blob, offsets, end)) {
+                qWarning() << "Could not write the packet index" << index_file;
+            }
         }
+
+        qDebug() << "Parsed" << end << "total bytes.";
+        return true;
     }
 
     return false;
 }
 
+bool CTcpDumpData::setFilter(const QString &expression)
+{
+    if(!m_filter.compile(expression)) {
+        qWarning() << "Invalid packet filter:" << m_filter.errorString();
+        return false;
+    }
+
+    return true;
+}
+
 qint32 CTcpDumpData::availablePackets() const
 {
     return m_packets.size();
 }
 
+qint32 CTcpDumpData::filteredPackets() const
+{
+    return m_filtered_packets;
+}
+
 QSharedPointer<const CTcpDumpPacket> CTcpDumpData::getPacket(int i) const
 {
     if(i < availablePackets()) {
@@ -74,22 +123,22 @@ QSharedPointer<const CTcpDumpPacket> CTcpDumpData::getPacket(int i) const
     }
 }
 
-bool CTcpDumpData::validIp(QSharedPointer<CTcpDumpPacket> packet)
+bool CTcpDumpData::validIp(QSharedPointer<CTcpDumpPacket> packet) const
 {
     if(packet->ip == 0) {
         return true;
     }
 
-    quint32 t = 0;
-    for(int i = packet->ipheaderlen() - 2; i >= 0; i -= 2) {
-        t += packet->get2((packet->ip) + i);
+    // The header must have been captured entirely.
+    quint32 header_length = packet->ipheaderlen();
+    if(packet->ip + header_length > static_cast<quint32>(packet->data.size())) {
+        return false;
     }
-    t = (t >> 16) + (t & 0xffff);
 
-    return t == 0xffff;
+    return CIpChecksum::valid(packet->data.constData() + packet->ip, header_length);
 }
 
-bool CTcpDumpData::defrag(QSharedPointer<CTcpDumpPacket> packet)
+bool CTcpDumpData::defrag(QSharedPointer<CTcpDumpPacket> packet) const
 {
     if(packet->fragoffset() == 0 && !packet->fragfollows()) {
         // Not fragmented.
@@ -135,74 +184,236 @@ quint32 CTcpDumpData::parseHeader(const QByteArray &blob)
 }
 
 
-quint32 CTcpDumpData::parsePackets(const QByteArray &blob, quint32 offset)
+quint32 CTcpDumpData::indexPackets(const QByteArray &blob, quint32 offset,
+                                   QVector<quint32> &offsets)
 {
     quint32 blob_size = blob.size();
+    const char *bytes = blob.constData();
 
-    while(offset < blob_size) {
-        QSharedPointer<CTcpDumpPacket> p(new CTcpDumpPacket());
-
-        p->time = get4Bytes(blob, offset);
-        offset += 4;
-        p->time += get4Bytes(blob, offset) * 0.000001; // Microseconds
-        offset += 4;
+    // Only the record headers are read here, the packets are decoded later.
+    while(blob_size - offset >= RECORD_HEADER_SIZE) {
         // The number of bytes captured in the tcp dump.
-        p->capture_length = get4Bytes(blob, offset);
-        offset += 4;
+        quint32 capture_length = read4Bytes(bytes + offset + 8);
         // The theoretical size of the packet.
-        p->frame_length = get4Bytes(blob, offset);
-        offset += 4;
-        if(p->frame_length > 65535) {
+        quint32 frame_length = read4Bytes(bytes + offset + 12);
+        if(frame_length > 65535) {
             qWarning() << "Packet size too large.";
             return offset;
         }
+        if(capture_length > blob_size - offset - RECORD_HEADER_SIZE) {
+            // Error: the file is not long enough.
+            qWarning() << "The TCP dump file is not long enough.";
+            return offset;
+        }
 
-        // Read ethernet part of packet that was captured.
-        p->data.resize(p->capture_length);
-        for(quint32 i = 0; i < p->capture_length; ++i) {
-            quint8 byte;
-            if(offset < blob_size) {
-                byte = blob.at(offset++);
+        offsets.append(offset);
+        offset += RECORD_HEADER_SIZE + capture_length;
+    }
+
+    if(offset < blob_size) {
+        qWarning() << "The TCP dump file ends with a truncated record header.";
+    }
+
+    return offset;
+}
+
+bool CTcpDumpData::parsePackets(const QByteArray &blob,
+                                const QVector<quint32> &offsets, quint32 end)
+{
+    qint32 packet_count = offsets.size();
+    QAtomicInt valid(1);
+
+    m_packets.clear();
+    m_packets.resize(packet_count);
+
+    // Decode the packets in ranges spread among the threads. Ranges are
+    // ... processed in batches so that the progress is reported from here.
+    const qint32 range_size = 4096;
+    const qint32 batch_size = range_size * 64;
+    for(qint32 batch = 0; batch < packet_count && valid.load(); batch += batch_size) {
+        QVector<QPair<qint32, qint32>> ranges;
+        qint32 batch_end = qMin(batch + batch_size, packet_count);
+        for(qint32 i = batch; i < batch_end; i += range_size) {
+            ranges.append(qMakePair(i, qMin(i + range_size, batch_end)));
+        }
+
+        QtConcurrent::blockingMap(ranges, [&] (const QPair<qint32, qint32> &range) {
+            if(!parseRange(blob, offsets, end, range.first, range.second)) {
+                valid.store(0);
+            }
+        });
+
+        // Report progress every so often.
+        qint64 percentage = static_cast<qint64>(batch_end) * 100 / packet_count;
+        nodeReport(static_cast<qint8>(percentage));
+    }
+
+    if(!valid.load()) {
+        m_packets.clear();
+        return false;
+    }
+
+    // Remove the slots of the packets that were filtered.
+    if(!m_filter.isEmpty()) {
+        m_packets.erase(std::remove(m_packets.begin(), m_packets.end(),
+                                    QSharedPointer<CTcpDumpPacket>()),
+                        m_packets.end());
+        m_packets.squeeze();
+    }
+    m_filtered_packets = packet_count - m_packets.size();
+
+    return true;
+}
+
+bool CTcpDumpData::parseRange(const QByteArray &blob,
+                              const QVector<quint32> &offsets, quint32 end,
+                              qint32 first, qint32 last)
+{
+    quint32 blob_size = blob.size();
+    const uchar *bytes = reinterpret_cast<const uchar *>(blob.constData());
+    qint32 count = last - first;
+
+    // The IP headers found in the range. 'ip_headers' holds the position of
+    // ... the header of each packet in 'ip_offsets', NO_IP_HEADER if the
+    // ... packet is not IPv4 or TRUNCATED_IP_HEADER if it was not captured.
+    const qint32 NO_IP_HEADER = -1;
+    const qint32 TRUNCATED_IP_HEADER = -2;
+    QVector<qint32> ip_headers(count);
+    QVector<qint32> ip_offsets;
+    QVector<quint8> ip_lengths;
+    ip_offsets.reserve(count);
+    ip_lengths.reserve(count);
+
+    for(qint32 i = first; i < last; ++i) {
+        // Every record must end where the next one begins.
+        quint32 offset = offsets.at(i);
+        quint32 next = i + 1 < offsets.size() ? offsets.at(i + 1) : end;
+        if(next > blob_size || next < offset ||
+           next - offset < RECORD_HEADER_SIZE ||
+           read4Bytes(blob.constData() + offset + 8) != next - offset - RECORD_HEADER_SIZE ||
+           read4Bytes(blob.constData() + offset + 12) > 65535) {
+            return false;
+        }
+
+        // Find the IPv4 header the same way parsePacket() does.
+        const uchar *frame = bytes + offset + RECORD_HEADER_SIZE;
+        quint32 length = next - offset - RECORD_HEADER_SIZE;
+        qint32 &ip_header = ip_headers[i - first];
+        ip_header = NO_IP_HEADER;
+        if(length > 34 && ((frame[12] << 8) | frame[13]) == 0x800 &&
+           (frame[14] & 0xf0) == 0x40) {
+            quint32 header_length = (frame[14] & 15) * 4;
+            if(14 + header_length <= length) {
+                ip_header = ip_offsets.size();
+                ip_offsets.append(offset + RECORD_HEADER_SIZE + 14);
+                ip_lengths.append(header_length);
             }
             else {
-                // Error: the file is not long enough.
-                qWarning() << "The TCP dump file is not long enough.";
-                return offset;
+                ip_header = TRUNCATED_IP_HEADER;
             }
-            p->data[i] = byte;
         }
+    }
 
-        p->end = p->data.size();
-
-        // Parse the EtherType.
-        // Set ip to the offset 14 if this packet is a IPv4 packet.
-        if (p->capture_length > 34 &&
-            p->get2(12) == 0x800 &&
-            (p->get1(14) & 0xf0) == 0x40) {
-            p->ip=14;
+    // Validate all the IP checksums of the range at once.
+    QVector<quint8> ip_valid(ip_offsets.size());
+    CIpChecksum::valid(bytes, ip_offsets.constData(), ip_lengths.constData(),
+                       ip_offsets.size(), ip_valid.data());
+
+    for(qint32 i = first; i < last; ++i) {
+        quint32 offset = offsets.at(i);
+        quint32 next = i + 1 < offsets.size() ? offsets.at(i + 1) : end;
+        qint32 ip_header = ip_headers.at(i - first);
+        bool valid_ip = ip_header == NO_IP_HEADER ||
+                (ip_header >= 0 && ip_valid.at(ip_header));
+
+        // Discard filtered packets before they are decoded.
+        if(m_filter.match(bytes + offset + RECORD_HEADER_SIZE,
+                          next - offset - RECORD_HEADER_SIZE, valid_ip)) {
+            m_packets[i] = parsePacket(blob, offset, valid_ip);
         }
+    }
 
-        // Parse the protocol layer if it's a valid IP packet and it's not
-        // ... fragmented.
-        if(validIp(p) && defrag(p)) {
-            parseIpProtocol(p);
-        }
+    return true;
+}
 
-        // Save the packet.
-        m_packets.append(p);
+QSharedPointer<CTcpDumpPacket> CTcpDumpData::parsePacket(const QByteArray &blob,
+                                                         quint32 offset,
+                                                         bool valid_ip) const
+{
+    const char *bytes = blob.constData() + offset;
+    QSharedPointer<CTcpDumpPacket> p(new CTcpDumpPacket());
+
+    p->time = read4Bytes(bytes);
+    p->time += read4Bytes(bytes + 4) * 0.000001; // Microseconds
+    // The number of bytes captured in the tcp dump.
+    p->capture_length = read4Bytes(bytes + 8);
+    // The theoretical size of the packet.
+    p->frame_length = read4Bytes(bytes + 12);
+
+    // Read ethernet part of packet that was captured.
+    bytes += RECORD_HEADER_SIZE;
+    p->data.resize(p->capture_length);
+    std::copy(bytes, bytes + p->capture_length, p->data.begin());
+
+    p->end = p->data.size();
+
+    // Parse the EtherType.
+    // Set ip to the offset 14 if this packet is a IPv4 packet.
+    if (p->capture_length > 34 &&
+        p->get2(12) == 0x800 &&
+        (p->get1(14) & 0xf0) == 0x40) {
+        p->ip=14;
+    }
 
-        // Report progress every so often.
-        if(m_packets.size() % 80000 == 0) {
-            qint64 percentage = static_cast<qint64>(offset) * 100 /
-                    static_cast<qint64>(blob_size);
-            nodeReport(static_cast<qint8>(percentage));
-        }
+    // Parse the protocol layer if it's a valid IP packet and it's not
+    // ... fragmented.
+    if(valid_ip && defrag(p)) {
+        parseIpProtocol(p);
     }
 
-    return offset;
+    return p;
+}
+
+bool CTcpDumpData::loadIndex(const QString &index_file, const QByteArray &blob,
+                             QVector<quint32> &offsets, quint32 &end) const
+{
+    QFile file(index_file);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic, version;
+    quint64 blob_size;
+    in >> magic >> version >> blob_size;
+    // The index is only valid for a dump of the same size.
+    if(in.status() != QDataStream::Ok || magic != INDEX_MAGIC ||
+       version != INDEX_VERSION ||
+       blob_size != static_cast<quint64>(blob.size())) {
+        return false;
+    }
+
+    in >> end >> offsets;
+
+    return in.status() == QDataStream::Ok;
+}
+
+bool CTcpDumpData::saveIndex(const QString &index_file, const QByteArray &blob,
+                             const QVector<quint32> &offsets, quint32 end) const
+{
+    QFile file(index_file);
+    if(!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << INDEX_MAGIC << INDEX_VERSION << static_cast<quint64>(blob.size());
+    out << end << offsets;
+
+    return out.status() == QDataStream::Ok;
 }
 
-quint32 CTcpDumpData::get4Bytes(const QByteArray &blob, quint32 offset)
+quint32 CTcpDumpData::get4Bytes(const QByteArray &blob, quint32 offset) const
 {
     quint32 number = 0;
     quint32 blob_size = blob.size();
@@ -230,7 +441,7 @@ quint32 CTcpDumpData::get4Bytes(const QByteArray &blob, quint32 offset)
     return number;
 }
 
-void CTcpDumpData::parseIpProtocol(QSharedPointer<CTcpDumpPacket> packet)
+void CTcpDumpData::parseIpProtocol(QSharedPointer<CTcpDumpPacket> packet) const
 {
     qint8 protocol = packet->protocol();
 
@@ -2,10 +2,12 @@
 #define TCPDUMPDATA_H
 
 #include "tcpdumppacket.h"
+#include "packetfilter.h"
 #include "data/data.h"
 #include "node/node.h"
-#include <QList>
+#include <QVector>
 #include <QByteArray>
+#include <QString>
 #include <QSharedPointer>
 
 
@@ -15,7 +17,10 @@ class CTcpDumpData: public CData
     // Structures and variables.
     QByteArray m_magic_word;
     bool m_little_endian;
-    QList<QSharedPointer<CTcpDumpPacket>> m_packets;
+    QVector<QSharedPointer<CTcpDumpPacket>> m_packets;
+    // Only packets matching the filter are stored.
+    CPacketFilter m_filter;
+    qint32 m_filtered_packets;
     CNode *m_reporting_node;
 
   public:
@@ -28,25 +33,69 @@ class CTcpDumpData: public CData
     void unsetNodeReporter();
     // The progress we are reporting using 'm_reporting_node'.
     void nodeReport(qint8 percentage);
+    // Set the filter expression (see CPacketFilter) applied while parsing.
+    // ... Return false if the expression is not valid.
+    bool setFilter(const QString &expression);
     // Parse a byte array into several packets. Extract the tcp dump magic word too.
-    bool parse(const QByteArray &blob);
+    // ... If 'index_file' is given, the offsets of the packets are read from it
+    // ... when it matches 'blob' and are written to it otherwise.
+    bool parse(const QByteArray &blob, const QString &index_file = QString());
     // How many packets are available.
     qint32 availablePackets() const;
+    // How many packets were discarded by the filter.
+    qint32 filteredPackets() const;
     QSharedPointer<const CTcpDumpPacket> getPacket(int i) const;
     // If the IP checksum of the specified packet is correct, or if the packet
     // ... is not an IP packet return true.
-    bool validIp(QSharedPointer<CTcpDumpPacket> packet);
+    bool validIp(QSharedPointer<CTcpDumpPacket> packet) const;
     // Return true if the IP packet is not fragmented.
-    bool defrag(QSharedPointer<CTcpDumpPacket> packet);
+    bool defrag(QSharedPointer<CTcpDumpPacket> packet) const;
 
   private:
     quint32 parseHeader(const QByteArray &blob);
-    // Parse a TCP packet and return how many bytes were used in the parsing.
-    quint32 parsePackets(const QByteArray &blob, quint32 offset);
+    // Walk the record headers starting at 'offset' and store where each
+    // ... record starts. Return the offset after the last complete record.
+    quint32 indexPackets(const QByteArray &blob, quint32 offset,
+                         QVector<quint32> &offsets);
+    // Decode the records found at 'offsets' in parallel. Return false if the
+    // ... offsets do not describe a chain of records ending at 'end'.
+    bool parsePackets(const QByteArray &blob, const QVector<quint32> &offsets,
+                      quint32 end);
+    // Decode the records from 'first' to 'last' (excluded), validating their
+    // ... IP checksums in a batch. Return false if the records are not chained.
+    bool parseRange(const QByteArray &blob, const QVector<quint32> &offsets,
+                    quint32 end, qint32 first, qint32 last);
+    // Decode the record starting at 'offset'. 'valid_ip' tells if the IP
+    // ... checksum is correct (or if there is no IP header).
+    QSharedPointer<CTcpDumpPacket> parsePacket(const QByteArray &blob,
+                                               quint32 offset,
+                                               bool valid_ip) const;
+    // Read and write the packet offsets of 'blob' from and to 'index_file'.
+    bool loadIndex(const QString &index_file, const QByteArray &blob,
+                   QVector<quint32> &offsets, quint32 &end) const;
+    bool saveIndex(const QString &index_file, const QByteArray &blob,
+                   const QVector<quint32> &offsets, quint32 end) const;
     // Return 4 bytes as a single number taking into account endianess.
-    quint32 get4Bytes(const QByteArray &blob, quint32 offset);
+    quint32 get4Bytes(const QByteArray &blob, quint32 offset) const;
+    // Same as get4Bytes() without bounds checking.
+    inline quint32 read4Bytes(const char *bytes) const;
     // Parse the protocol layer.
-    void parseIpProtocol(QSharedPointer<CTcpDumpPacket> packet);
+    void parseIpProtocol(QSharedPointer<CTcpDumpPacket> packet) const;
 };
 
+
+// Inline functions
+
+quint32 CTcpDumpData::read4Bytes(const char *bytes) const
+{
+    const uchar *b = reinterpret_cast<const uchar *>(bytes);
+
+    if(m_little_endian) {
+        return b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<quint32>(b[3]) << 24);
+    }
+    else {
+        return (static_cast<quint32>(b[0]) << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+    }
+}
+
 #endif // TCPDUMPDATA_H
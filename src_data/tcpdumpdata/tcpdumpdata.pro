@@ -1,4 +1,5 @@
 QT += core
+QT += concurrent
 QT -= gui
 
 TARGET = tcpdumpdata
@@ -29,8 +30,14 @@ QMAKE_CLEAN += $$DESTDIR/*$$TARGET*
 HEADERS += \
     tcpdumpdata.h \
     interface.h \
-    tcpdumppacket.h
+    tcpdumppacket.h \
+    packetfilter.h \
+    networkset.h \
+    ipchecksum.h
 
 SOURCES += \
     tcpdumpdata.cpp \
-    interface.cpp
+    interface.cpp \
+    packetfilter.cpp \
+    networkset.cpp \
+    ipchecksum.cpp
@@ -0,0 +1,149 @@
+#include "tcpflowtable.h"
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CTcpStreamSlab::CTcpStreamSlab()
+    : m_blocks()
+    , m_block_used(0)
+    , m_free()
+{
+
+}
+
+CTcpStreamSlab::~CTcpStreamSlab()
+{
+    for(CTcpStream *block : m_blocks) {
+        delete[] block;
+    }
+}
+
+CTcpFlowTable::CTcpFlowTable()
+    : m_entries()
+    , m_mask(0)
+    , m_size(0)
+{
+    rehash(1024);
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+void CTcpStreamSlab::adopt(CTcpStreamSlab &other)
+{
+    if(m_blocks.isEmpty()) {
+        m_blocks.swap(other.m_blocks);
+        m_block_used = other.m_block_used;
+    }
+    else {
+        // Keep allocating from our own last block.
+        CTcpStream *last = m_blocks.takeLast();
+        m_blocks.append(other.m_blocks);
+        m_blocks.append(last);
+        other.m_blocks.clear();
+    }
+    other.m_block_used = 0;
+    m_free.append(other.m_free);
+    other.m_free.clear();
+}
+
+CTcpStream *&CTcpFlowTable::findOrInsert(const CTcpKey &key)
+{
+    // Keep the load factor below 1/2 so that probe sequences stay short.
+    if((m_size + 1) * 2 > m_entries.size()) {
+        rehash(m_entries.size() * 2);
+    }
+
+    SEntry *entries = m_entries.data();
+    quint32 i = static_cast<quint32>(key.hash()) & m_mask;
+
+    while(entries[i].stream) {
+        if(entries[i].key == key) {
+            return entries[i].stream;
+        }
+        i = (i + 1) & m_mask;
+    }
+
+    // Claim the empty slot for the key.
+    entries[i].key = key;
+    ++m_size;
+
+    return entries[i].stream;
+}
+
+CTcpStream *CTcpFlowTable::take(const CTcpKey &key)
+{
+    SEntry *entries = m_entries.data();
+    quint32 i = static_cast<quint32>(key.hash()) & m_mask;
+
+    while(entries[i].stream && !(entries[i].key == key)) {
+        i = (i + 1) & m_mask;
+    }
+
+    CTcpStream *stream = entries[i].stream;
+    if(!stream) {
+        return nullptr;
+    }
+
+    // Shift back the entries that follow in the probe sequence so that no
+    // ... tombstones are needed.
+    quint32 hole = i;
+    quint32 j = (i + 1) & m_mask;
+    while(entries[j].stream) {
+        quint32 home = static_cast<quint32>(entries[j].key.hash()) & m_mask;
+        // Can entry 'j' be moved into the hole without skipping its home?
+        if(((j - home) & m_mask) >= ((j - hole) & m_mask)) {
+            entries[hole] = entries[j];
+            hole = j;
+        }
+        j = (j + 1) & m_mask;
+    }
+    entries[hole] = SEntry();
+    --m_size;
+
+    return stream;
+}
+
+QList<CTcpStream *> CTcpFlowTable::values() const
+{
+    QList<CTcpStream *> streams;
+    streams.reserve(m_size);
+
+    for(const SEntry &entry : m_entries) {
+        if(entry.stream) {
+            streams.append(entry.stream);
+        }
+    }
+
+    return streams;
+}
+
+void CTcpFlowTable::clear()
+{
+    m_size = 0;
+    rehash(1024);
+}
+
+
+//------------------------------------------------------------------------------
+// Private Functions
+
+void CTcpFlowTable::rehash(qint32 capacity)
+{
+    QVector<SEntry> old_entries(capacity);
+    old_entries.swap(m_entries);
+    m_mask = static_cast<quint32>(capacity - 1);
+
+    SEntry *entries = m_entries.data();
+    for(const SEntry &entry : old_entries) {
+        if(entry.stream) {
+            quint32 i = static_cast<quint32>(entry.key.hash()) & m_mask;
+            while(entries[i].stream) {
+                i = (i + 1) & m_mask;
+            }
+            entries[i] = entry;
+        }
+    }
+}
@@ -0,0 +1,170 @@
+#ifndef TCPFLOWTABLE_H
+#define TCPFLOWTABLE_H
+
+#include "tcpstream.h"
+#include "tcpdumpdata/tcpdumppacket.h"
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+#include <QSharedPointer>
+
+
+// The identifier of a TCP flow packed into 12 bytes: both addresses share
+// ... a 64 bit word and both ports a 32 bit word.
+class CTcpKey
+{
+  public:
+    quint64 addresses;
+    quint32 ports;
+
+    CTcpKey(): addresses(0), ports(0) {}
+
+    CTcpKey(quint32 source_addr, quint32 destination_addr,
+            quint16 source_port, quint16 destination_port):
+        addresses((static_cast<quint64>(source_addr) << 32) | destination_addr),
+        ports((static_cast<quint32>(source_port) << 16) | destination_port) {}
+
+    CTcpKey(const QSharedPointer<const CTcpDumpPacket> &packet):
+        CTcpKey(packet->src(), packet->dest(),
+                packet->src_port(), packet->dest_port()) {}
+
+    CTcpKey(const CTcpStream &stream):
+        CTcpKey(stream.source_addr, stream.destination_addr,
+                stream.source_port, stream.destination_port) {}
+
+    bool operator ==(const CTcpKey &tcp_key) const
+    {
+        return addresses == tcp_key.addresses && ports == tcp_key.ports;
+    }
+
+    // Mix every bit of the key into the result (MurmurHash3 finalizer).
+    inline quint64 hash() const;
+
+    // A hash that is the same for both directions of a connection.
+    quint64 symmetricHash() const
+    {
+        quint32 source_addr = addresses >> 32;
+        quint32 destination_addr = addresses & 0xffffffff;
+        quint16 source_port = ports >> 16;
+        quint16 destination_port = ports & 0xffff;
+
+        if(source_addr > destination_addr ||
+           (source_addr == destination_addr && source_port > destination_port)) {
+            return CTcpKey(destination_addr, source_addr,
+                           destination_port, source_port).hash();
+        }
+        return hash();
+    }
+};
+
+
+// Allocate streams in blocks so that they are contiguous in memory and
+// ... their addresses remain valid while the slab is alive.
+class CTcpStreamSlab
+{
+  private:
+    static const qint32 BLOCK_SIZE = 1024;
+    QList<CTcpStream *> m_blocks;
+    // Streams handed out from the last block.
+    qint32 m_block_used;
+    // Released streams that can be handed out again.
+    QList<CTcpStream *> m_free;
+
+  public:
+    explicit CTcpStreamSlab();
+    ~CTcpStreamSlab();
+    // Get a default constructed stream owned by the slab.
+    inline CTcpStream *allocate();
+    // Give back a stream so that it can be allocated again.
+    inline void release(CTcpStream *stream);
+    // Take the ownership of all the streams of 'other'.
+    void adopt(CTcpStreamSlab &other);
+
+  private:
+    Q_DISABLE_COPY(CTcpStreamSlab)
+};
+
+
+// Open addressing hash table (linear probing) mapping flow keys to streams.
+class CTcpFlowTable
+{
+  private:
+    struct SEntry {
+        CTcpKey key;
+        // A null stream marks an empty slot.
+        CTcpStream *stream;
+        SEntry(): key(), stream(nullptr) {}
+    };
+
+    QVector<SEntry> m_entries;
+    quint32 m_mask;
+    qint32 m_size;
+
+  public:
+    explicit CTcpFlowTable();
+
+    // Return the stream stored with 'key' or nullptr if there is none.
+    inline CTcpStream *find(const CTcpKey &key) const;
+    // Return the slot of 'key', creating an empty one if needed. The caller
+    // ... must assign a stream to a newly created slot.
+    CTcpStream *&findOrInsert(const CTcpKey &key);
+    // Remove 'key' from the table and return its stream (or nullptr).
+    CTcpStream *take(const CTcpKey &key);
+    // Get all the streams stored in the table.
+    QList<CTcpStream *> values() const;
+    qint32 size() const { return m_size; }
+    void clear();
+
+  private:
+    void rehash(qint32 capacity);
+};
+
+
+// Inline functions
+
+quint64 CTcpKey::hash() const
+{
+    quint64 h = addresses ^ (ports * Q_UINT64_C(0x9e3779b97f4a7c15));
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+    return h;
+}
+
+CTcpStream *CTcpStreamSlab::allocate()
+{
+    if(!m_free.isEmpty()) {
+        return m_free.takeLast();
+    }
+    if(m_blocks.isEmpty() || m_block_used == BLOCK_SIZE) {
+        m_blocks.append(new CTcpStream[BLOCK_SIZE]);
+        m_block_used = 0;
+    }
+
+    return m_blocks.last() + m_block_used++;
+}
+
+void CTcpStreamSlab::release(CTcpStream *stream)
+{
+    *stream = CTcpStream();
+    m_free.append(stream);
+}
+
+CTcpStream *CTcpFlowTable::find(const CTcpKey &key) const
+{
+    const SEntry *entries = m_entries.constData();
+    quint32 i = static_cast<quint32>(key.hash()) & m_mask;
+
+    while(entries[i].stream) {
+        if(entries[i].key == key) {
+            return entries[i].stream;
+        }
+        i = (i + 1) & m_mask;
+    }
+
+    return nullptr;
+}
+
+#endif // TCPFLOWTABLE_H
@@ -8,6 +8,73 @@
 //------------------------------------------------------------------------------
 // Public Functions
 
+void CTcpStream::copy(const QSharedPointer<const CTcpDumpPacket> &tcp_packet,
+                      qint32 offset, qint32 length)
+{
+    if(length <= 0) {
+        return;
+    }
+
+    // The payload spans the requested length even when the packet carries
+    // ... fewer bytes (e.g., ethernet padding). Those bytes remain zero.
+    quint32 begin = offset;
+    quint32 end = begin + length;
+    payload_end = qMax(payload_end, end);
+    qint32 available = tcp_packet->end - tcp_packet->appl;
+    if(available <= 0) {
+        return;
+    }
+    end = qMin(end, begin + available);
+
+    // Most segments arrive in order and go after the last one.
+    if(segments.isEmpty() || begin >= segments.last().end()) {
+        segments.append(CTcpSegment(begin, end - begin, tcp_packet->appl,
+                                    tcp_packet->data));
+        payload_stored += end - begin;
+        return;
+    }
+
+    // Find the first segment that ends after the new one begins.
+    auto it = std::upper_bound(segments.begin(), segments.end(), begin,
+        [] (quint32 position, const CTcpSegment &segment) {
+            return position < segment.end();
+        });
+    qint32 i = it - segments.begin();
+
+    // Fill the gaps between the stored segments (retransmitted or
+    // ... overlapping bytes are not stored again).
+    quint32 position = begin;
+    while(position < end) {
+        if(i < segments.size() && segments[i].offset <= position) {
+            position = qMax(position, segments[i].end());
+            ++i;
+            continue;
+        }
+
+        quint32 gap_end = end;
+        if(i < segments.size()) {
+            gap_end = qMin(end, segments[i].offset);
+        }
+        segments.insert(i, CTcpSegment(position, gap_end - position,
+                                       tcp_packet->appl + (position - begin),
+                                       tcp_packet->data));
+        payload_stored += gap_end - position;
+        position = gap_end;
+        ++i;
+    }
+}
+
+QVector<quint8> CTcpStream::payload() const
+{
+    QVector<quint8> bytes(static_cast<qint32>(payload_end), 0);
+
+    for(const CTcpSegment &segment : segments) {
+        auto begin = segment.data.constBegin() + segment.start;
+        qCopy(begin, begin + segment.length, bytes.begin() + segment.offset);
+    }
+
+    return bytes;
+}
 
 
 //------------------------------------------------------------------------------
@@ -8,6 +8,25 @@
 #include <QSharedPointer>
 
 
+// A piece of the stream payload. The bytes are not copied, the segment
+// ... shares the data of the packet they arrived with.
+class CTcpSegment
+{
+  public:
+    quint32 offset; // Position of the segment in the stream payload.
+    quint32 length;
+    qint32 start; // Position of the first byte of the segment in 'data'.
+    QVector<quint8> data;
+
+    CTcpSegment(): offset(0), length(0), start(0) {}
+    CTcpSegment(quint32 p_offset, quint32 p_length, qint32 p_start,
+                const QVector<quint8> &p_data):
+        offset(p_offset), length(p_length), start(p_start), data(p_data) {}
+
+    quint32 end() const { return offset + length; }
+};
+
+
 class CTcpStream
 {
   public:
@@ -16,20 +35,32 @@ class CTcpStream
     quint16 source_port;
     quint16 destination_port;
     quint32 data_length; // Theoretical length of the communication.
-    QVector<quint8> payload;
+    // Stored payload, sorted by offset and without overlaps.
+    QVector<CTcpSegment> segments;
+    quint32 payload_end; // Length of the stream payload.
+    quint32 payload_stored; // Bytes referenced by the segments.
     quint32 payload_size;
     quint32 seq; // The initial TCP sequence number.
     double start_time, finish_time; // Time of first and last packet
     quint8 flags_first, flags_before_last, flags_last;
     quint32 total_packets;
+    // Neighbours in the list of open streams ordered by last activity.
+    CTcpStream *lru_prev, *lru_next;
+    // Position in the capture of the last packet of the stream and of the
+    // ... packet that closed it (-1 while open).
+    qint64 last_sequence, close_sequence;
+    // Closed because no packet arrived for too long.
+    bool idle_closed;
 
   public:
     CTcpStream(): source_addr(0), destination_addr(0),
                   source_port(0), destination_port(0),
-                  data_length(0), payload_size(0),
+                  data_length(0), payload_end(0), payload_stored(0),
+                  payload_size(0),
                   seq(0), start_time(0), finish_time(0),
                   flags_first(0), flags_before_last(0), flags_last(0),
-                  total_packets(0) {}
+                  total_packets(0), lru_prev(nullptr), lru_next(nullptr),
+                  last_sequence(-1), close_sequence(-1), idle_closed(false) {}
 
     void init(const QSharedPointer<const CTcpDumpPacket> &tcp_packet)
     {
@@ -54,20 +85,30 @@ class CTcpStream
         flags_last = tcp_packet->tcpflags();
     }
 
-    void copy(const QSharedPointer<const CTcpDumpPacket> &tcp_packet,
-              qint32 offset, qint32 length)
+    // Was the stream closed before 'other'? Streams closed by the same packet
+    // ... are ordered like a single structure closes them: the idle ones
+    // ... first, from the least recently active.
+    bool closedBefore(const CTcpStream &other) const
     {
-        // Increse the memory allocation of the vector.
-        if(payload.size() < offset + length) {
-            payload.resize(offset + length);
+        if(close_sequence != other.close_sequence) {
+            return close_sequence < other.close_sequence;
         }
-
-        // Copy the contents.
-        auto begin = tcp_packet->data.begin() + tcp_packet->appl;
-        auto end = tcp_packet->data.begin() + tcp_packet->end;
-        auto result = payload.begin() + offset;
-        qCopy(begin, end, result);
+        if(idle_closed != other.idle_closed) {
+            return idle_closed;
+        }
+        return idle_closed && last_sequence < other.last_sequence;
     }
+
+    // Bytes of payload held in memory by the stream.
+    qint32 payloadBytes() const { return payload_stored; }
+
+    // Store 'length' bytes of the packet payload at 'offset' of the stream.
+    // ... Bytes of the stream that are already stored are kept.
+    void copy(const QSharedPointer<const CTcpDumpPacket> &tcp_packet,
+              qint32 offset, qint32 length);
+
+    // Build the contiguous payload of the stream. Missing bytes are zeros.
+    QVector<quint8> payload() const;
 };
 
 Q_DECLARE_METATYPE(CTcpStream*)
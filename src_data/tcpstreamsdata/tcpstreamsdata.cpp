@@ -1,5 +1,6 @@
 #include "tcpstreamsdata.h"
 #include <QDebug>
+#include <algorithm>
 
 
 //------------------------------------------------------------------------------
@@ -8,27 +9,24 @@
 CTcpStreamsData::CTcpStreamsData()
     : CData()
     , m_max_payload_size(0)
+    , m_lru_head(nullptr)
+    , m_lru_tail(nullptr)
+    , m_idle_timeout(0)
+    , m_active_timeout(0)
+    , m_max_open_streams(0)
+    , m_max_open_payload(0)
+    , m_open_payload(0)
+    , m_closed_payload(0)
+    , m_timed_out_streams(0)
+    , m_evicted_streams(0)
+    , m_final(true)
 {
 
 }
 
 CTcpStreamsData::~CTcpStreamsData()
 {
-    // Delete open streams.
-    for(auto key : m_tcp_open_streams.keys()) {
-        CTcpStream* stream = m_tcp_open_streams.value(key);
-        if(stream) {
-            delete stream;
-        }
-    }
-
-    // Delete closed streams.
-    for(auto stream : m_tcp_closed_streams) {
-        if(stream) {
-            delete stream;
-        }
-    }
-
+    // Streams are owned and deleted by the slab.
 }
 
 
@@ -42,27 +40,49 @@ CDataPointer CTcpStreamsData::clone() const
 }
 
 void CTcpStreamsData::addTcpPacket(
-        const QSharedPointer<const CTcpDumpPacket> &tcp_packet)
+        const QSharedPointer<const CTcpDumpPacket> &tcp_packet, qint64 sequence)
 {
     // Ignore non TCP packets.
     if(!tcp_packet->tcp) {
         return;
     }
 
+    // Close the streams that have been idle for too long.
+    expireStreams(tcp_packet->time, sequence);
+
     // Get the key associated with this TCP stream and get the Stream
     // ... (or create a new one).
     CTcpKey tcp_key = CTcpKey(tcp_packet);
-    CTcpStream* &tcp_stream = m_tcp_open_streams[tcp_key];
+    CTcpStream* &tcp_stream = m_tcp_open_streams.findOrInsert(tcp_key);
+
+    // Has the stream been open for too long? Close it and start a new one.
+    if(tcp_stream && m_active_timeout > 0 &&
+       tcp_packet->time - tcp_stream->start_time > m_active_timeout) {
+        lruRemove(tcp_stream);
+        m_open_payload -= tcp_stream->payloadBytes();
+        m_closed_payload += tcp_stream->payloadBytes();
+        tcp_stream->close_sequence = sequence;
+        m_tcp_closed_streams.append(tcp_stream);
+        ++m_timed_out_streams;
+        tcp_stream = nullptr;
+    }
 
     // Is the stream new?
     if(!tcp_stream) {
         // It's new, so create and initialize it.
-        tcp_stream = new CTcpStream();
+        tcp_stream = m_slab.allocate();
         tcp_stream->init(tcp_packet);
     }
+    else {
+        lruRemove(tcp_stream);
+    }
+    // The stream is now the most recently active one.
+    lruPushFront(tcp_stream);
+    qint32 stored_payload = tcp_stream->payloadBytes();
 
     // Update the stream records with details of the packet.
     tcp_stream->update(tcp_packet);
+    tcp_stream->last_sequence = sequence;
 
     // Get the length of the payload available.
     qint32 payload_length = tcp_packet->capture_length - tcp_packet->appl;
@@ -77,7 +97,8 @@ void CTcpStreamsData::addTcpPacket(
     if(payload_length > 0) {
         // Record the payload length.
         tcp_stream->payload_size += payload_length;
-        // Where to store the payload.
+        // Where to store the payload. Sequence numbers wrap around, so the
+        // ... offset is their difference modulo 2^32.
         qint32 offset = tcp_packet->tcpseq() - tcp_stream->seq;
         if(offset >= 0 && offset < static_cast<qint32>(m_max_payload_size)) {
             // Will the payload of the current packet go beyond the limit?
@@ -89,15 +110,172 @@ void CTcpStreamsData::addTcpPacket(
             tcp_stream->copy(tcp_packet, offset, payload_length);
         }
     }
+    m_open_payload += tcp_stream->payloadBytes() - stored_payload;
 
     // If this was a FIN or RST marked packet, close the stream.
     if(tcp_packet->fin() || tcp_packet->rst()) {
         // Move the stream to the structure of the closed ones.
-        m_tcp_closed_streams.append(m_tcp_open_streams.take(tcp_key));
+        closeStream(tcp_stream, sequence);
+    }
+
+    // Keep the open streams within their limits.
+    evictStreams(sequence);
+}
+
+void CTcpStreamsData::advanceTime(double time, qint64 sequence)
+{
+    expireStreams(time, sequence);
+}
+
+void CTcpStreamsData::merge(CTcpStreamsData &other)
+{
+    m_slab.adopt(other.m_slab);
+    m_tcp_closed_streams.append(other.m_tcp_closed_streams);
+
+    for(CTcpStream *stream : other.m_tcp_open_streams.values()) {
+        CTcpStream* &tcp_stream = m_tcp_open_streams.findOrInsert(CTcpKey(*stream));
+        if(tcp_stream) {
+            // The same flow is open in both structures: close the old one.
+            m_open_payload -= tcp_stream->payloadBytes();
+            m_closed_payload += tcp_stream->payloadBytes();
+            tcp_stream->close_sequence = tcp_stream->last_sequence;
+            m_tcp_closed_streams.append(tcp_stream);
+        }
+        tcp_stream = stream;
+    }
+    lruRebuild();
+    sortClosedStreams();
+
+    m_open_payload += other.m_open_payload;
+    m_closed_payload += other.m_closed_payload;
+    m_timed_out_streams += other.m_timed_out_streams;
+    m_evicted_streams += other.m_evicted_streams;
+
+    // Leave 'other' empty.
+    other.m_tcp_closed_streams.clear();
+    other.m_tcp_open_streams.clear();
+    other.m_lru_head = nullptr;
+    other.m_lru_tail = nullptr;
+    other.m_open_payload = 0;
+    other.m_closed_payload = 0;
+    other.m_timed_out_streams = 0;
+    other.m_evicted_streams = 0;
+}
+
+void CTcpStreamsData::moveClosedStreams(CTcpStreamsData &target)
+{
+    for(CTcpStream *stream : m_tcp_closed_streams) {
+        // The payload segments are shared, so swapping is cheap.
+        CTcpStream *target_stream = target.m_slab.allocate();
+        qSwap(*target_stream, *stream);
+        m_slab.release(stream);
+        target.m_tcp_closed_streams.append(target_stream);
     }
+    m_tcp_closed_streams.clear();
+    target.sortClosedStreams();
+
+    // The payload of the closed streams is now held by 'target'.
+    target.m_closed_payload += m_closed_payload;
+    m_closed_payload = 0;
+
+    target.m_timed_out_streams += m_timed_out_streams;
+    target.m_evicted_streams += m_evicted_streams;
+    m_timed_out_streams = 0;
+    m_evicted_streams = 0;
 }
 
 
 //------------------------------------------------------------------------------
 // Private Functions
 
+void CTcpStreamsData::closeStream(CTcpStream *stream, qint64 sequence,
+                                  bool idle/* = false*/)
+{
+    lruRemove(stream);
+    m_open_payload -= stream->payloadBytes();
+    m_closed_payload += stream->payloadBytes();
+    m_tcp_open_streams.take(CTcpKey(*stream));
+    stream->close_sequence = sequence;
+    stream->idle_closed = idle;
+    m_tcp_closed_streams.append(stream);
+}
+
+void CTcpStreamsData::expireStreams(double now, qint64 sequence)
+{
+    if(m_idle_timeout <= 0) {
+        return;
+    }
+
+    // The least recently active streams are at the tail of the list.
+    while(m_lru_tail && now - m_lru_tail->finish_time > m_idle_timeout) {
+        closeStream(m_lru_tail, sequence, true);
+        ++m_timed_out_streams;
+    }
+}
+
+void CTcpStreamsData::evictStreams(qint64 sequence)
+{
+    while(m_lru_tail &&
+          ((m_max_open_streams > 0 &&
+            static_cast<quint32>(m_tcp_open_streams.size()) > m_max_open_streams) ||
+           (m_max_open_payload > 0 && m_open_payload > m_max_open_payload))) {
+        closeStream(m_lru_tail, sequence);
+        ++m_evicted_streams;
+    }
+}
+
+void CTcpStreamsData::sortClosedStreams()
+{
+    std::stable_sort(m_tcp_closed_streams.begin(), m_tcp_closed_streams.end(),
+        [] (const CTcpStream *s1, const CTcpStream *s2) {
+            return s1->closedBefore(*s2);
+        });
+}
+
+void CTcpStreamsData::lruPushFront(CTcpStream *stream)
+{
+    stream->lru_prev = nullptr;
+    stream->lru_next = m_lru_head;
+    if(m_lru_head) {
+        m_lru_head->lru_prev = stream;
+    }
+    else {
+        m_lru_tail = stream;
+    }
+    m_lru_head = stream;
+}
+
+void CTcpStreamsData::lruRemove(CTcpStream *stream)
+{
+    if(stream->lru_prev) {
+        stream->lru_prev->lru_next = stream->lru_next;
+    }
+    else {
+        m_lru_head = stream->lru_next;
+    }
+
+    if(stream->lru_next) {
+        stream->lru_next->lru_prev = stream->lru_prev;
+    }
+    else {
+        m_lru_tail = stream->lru_prev;
+    }
+
+    stream->lru_prev = nullptr;
+    stream->lru_next = nullptr;
+}
+
+void CTcpStreamsData::lruRebuild()
+{
+    QList<CTcpStream *> streams = m_tcp_open_streams.values();
+    std::stable_sort(streams.begin(), streams.end(),
+        [] (const CTcpStream *s1, const CTcpStream *s2) {
+            return s1->last_sequence < s2->last_sequence;
+        });
+
+    m_lru_head = nullptr;
+    m_lru_tail = nullptr;
+    for(CTcpStream *stream : streams) {
+        lruPushFront(stream);
+    }
+}
@@ -2,62 +2,75 @@
 #define TCPSTREAMSDATA_H
 
 #include "tcpstream.h"
+#include "tcpflowtable.h"
 #include "data/data.h"
 #include "tcpdumpdata/tcpdumppacket.h"
-#include <QMap>
 #include <QList>
 
 
-class CTcpKey
-{
-  public:
-    quint32 source_addr;
-    quint32 destination_addr;
-    quint16 source_port;
-    quint16 destination_port;
-
-    CTcpKey(): source_addr(0), destination_addr(0),
-               source_port(0), destination_port(0) {}
-
-    CTcpKey(const QSharedPointer<const CTcpDumpPacket> &packet):
-        source_addr(packet->src()),
-        destination_addr(packet->dest()),
-        source_port(packet->src_port()),
-        destination_port(packet->dest_port()) {}
-
-    bool operator <(const CTcpKey& tcp_key) const
-    {
-        if(source_addr != tcp_key.source_addr) {
-          return source_addr < tcp_key.source_addr;
-        }
-        else if(destination_addr != tcp_key.destination_addr) {
-          return destination_addr < tcp_key.destination_addr;
-        }
-        else if(source_port != tcp_key.source_port) {
-          return source_port < tcp_key.source_port;
-        }
-
-        return destination_port < tcp_key.destination_port;
-    }
-};
-
-
 class CTcpStreamsData: public CData
 {
   private:
-    QMap<CTcpKey, CTcpStream*> m_tcp_open_streams;
+    // Storage of every stream, open or closed.
+    CTcpStreamSlab m_slab;
     QList<CTcpStream*> m_tcp_closed_streams;
+    CTcpFlowTable m_tcp_open_streams;
     quint32 m_max_payload_size;
+    // Open streams from the most (head) to the least (tail) recently active.
+    CTcpStream *m_lru_head;
+    CTcpStream *m_lru_tail;
+    // Limits that bound the open streams. A value of 0 disables a limit.
+    double m_idle_timeout;
+    double m_active_timeout;
+    quint32 m_max_open_streams;
+    quint64 m_max_open_payload;
+    // Payload bytes held by the open streams and by the closed streams that
+    // ... have not been moved out yet.
+    quint64 m_open_payload;
+    quint64 m_closed_payload;
+    // Streams closed because of the timeouts or the limits.
+    qint32 m_timed_out_streams;
+    qint32 m_evicted_streams;
+    // False if more streams of the same capture will follow.
+    bool m_final;
 
   public:
     explicit CTcpStreamsData();
     virtual ~CTcpStreamsData();
     virtual CDataPointer clone() const;
     void setMaxPayloadSize(quint32 size) { m_max_payload_size = size; }
-
-    // Add a TCP packet to a new or existing TCPStream.
-    void addTcpPacket(const QSharedPointer<const CTcpDumpPacket> &tcp_packet);
+    // Close streams without packets for 'seconds' (idle) or that have been
+    // ... open for longer than 'seconds' (active).
+    void setIdleTimeout(double seconds) { m_idle_timeout = seconds; }
+    void setActiveTimeout(double seconds) { m_active_timeout = seconds; }
+    // Close the least recently active streams whenever the open streams
+    // ... exceed 'count' streams or 'bytes' bytes of payload. Closed streams
+    // ... keep their payload until they are moved out with
+    // ... moveClosedStreams(), so only the open streams are bounded.
+    void setMaxOpenStreams(quint32 count) { m_max_open_streams = count; }
+    void setMaxOpenPayload(quint64 bytes) { m_max_open_payload = bytes; }
+
+    // Add a TCP packet to a new or existing TCPStream. 'sequence' is the
+    // ... position of the packet in the capture.
+    void addTcpPacket(const QSharedPointer<const CTcpDumpPacket> &tcp_packet,
+                      qint64 sequence);
+    // A packet followed by another structure arrived: close the streams
+    // ... that are idle at its 'time'. Structures that split the flows of a
+    // ... capture then close the same streams as a single one would.
+    void advanceTime(double time, qint64 sequence);
+    // Move all the streams of 'other' into this structure. The closed
+    // ... streams stay in the order they were closed.
+    void merge(CTcpStreamsData &other);
+    // Move the closed streams (and their counters) into 'target', in the
+    // ... order they were closed. The open streams stay here.
+    void moveClosedStreams(CTcpStreamsData &target);
+    // Structures sent while a capture is still being processed are not
+    // ... final; the last one is.
+    void setFinal(bool final) { m_final = final; }
+    bool isFinal() const { return m_final; }
+    // The open streams from the least to the most recently active.
     inline QList<CTcpStream*> getOpenStreams() const;
+    // The closed streams in the order they were closed.
     inline QList<CTcpStream*> getClosedStreams() const;
     // The open streams available.
     qint32 openStreamsCount() const { return m_tcp_open_streams.size(); }
@@ -65,6 +78,28 @@ class CTcpStreamsData: public CData
     qint32 closedStreamsCount() const { return m_tcp_closed_streams.size(); }
     // The total streams we currently have (open and closed).
     qint32 totalStreamsCount() const {return openStreamsCount() + closedStreamsCount(); }
+    // Payload bytes held by the open and by the closed streams.
+    quint64 openPayload() const { return m_open_payload; }
+    quint64 closedPayload() const { return m_closed_payload; }
+    // Streams closed by the idle or active timeouts.
+    qint32 timedOutStreamsCount() const { return m_timed_out_streams; }
+    // Streams closed to stay within the limits of open streams and payload.
+    qint32 evictedStreamsCount() const { return m_evicted_streams; }
+
+  private:
+    // Move an open stream to the list of closed streams. 'sequence' is the
+    // ... position of the packet that closed it.
+    void closeStream(CTcpStream *stream, qint64 sequence, bool idle = false);
+    // Close the streams that timed out or exceed the limits.
+    void expireStreams(double now, qint64 sequence);
+    void evictStreams(qint64 sequence);
+    // Order the list of closed streams after adding streams to it.
+    void sortClosedStreams();
+    // Maintain the list of open streams ordered by activity.
+    void lruPushFront(CTcpStream *stream);
+    void lruRemove(CTcpStream *stream);
+    // Order the list of open streams by the position of their last packet.
+    void lruRebuild();
 };
 
 Q_DECLARE_METATYPE(CTcpStreamsData*)
@@ -75,7 +110,12 @@ Q_DECLARE_METATYPE(const CTcpStreamsData*)
 
 QList<CTcpStream*> CTcpStreamsData::getOpenStreams() const
 {
-    return m_tcp_open_streams.values();
+    QList<CTcpStream*> streams;
+    streams.reserve(m_tcp_open_streams.size());
+    for(CTcpStream *stream = m_lru_tail; stream; stream = stream->lru_prev) {
+        streams.append(stream);
+    }
+    return streams;
 }
 
 QList<CTcpStream*> CTcpStreamsData::getClosedStreams() const
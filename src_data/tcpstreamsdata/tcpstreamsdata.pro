@@ -30,10 +30,12 @@ QMAKE_CLEAN += $$DESTDIR/*$$TARGET*
 HEADERS += \
     tcpstreamsdata.h \
     interface.h \
-    tcpstream.h
+    tcpstream.h \
+    tcpflowtable.h
 
 SOURCES += \
     tcpstreamsdata.cpp \
     interface.cpp \
-    tcpstream.cpp
+    tcpstream.cpp \
+    tcpflowtable.cpp
 
@@ -189,6 +189,23 @@ void CNode::logWarning(QString warning, const char *file, int line, const char *
 //------------------------------------------------------------------------------
 // Protected Functions
 
+QString CNode::inputFilter(QString gate_name) const
+{
+    Q_UNUSED(gate_name);
+
+    // By default nodes use all the data they receive.
+    return QString();
+}
+
+bool CNode::acceptFilter(QString gate_name, QString filter)
+{
+    Q_UNUSED(gate_name);
+    Q_UNUSED(filter);
+
+    // By default nodes cannot filter what they send.
+    return false;
+}
+
 CData *CNode::createData(QString data_name)
 {
     if(m_data_factory == nullptr) {
@@ -76,6 +76,14 @@ class CNode : public QObject
     // ... performed in another thread. Returns true if the data was
     // ... processed by the Node.
     virtual bool data(QString gate_name, const CConstDataPointer &data) = 0;
+    // Optional: return a filter expression describing the only data this
+    // ... node uses from the input 'gate_name', or an empty string if it
+    // ... needs all of it. The filter is offered to the nodes connected to
+    // ... the gate before the nodes are started.
+    virtual QString inputFilter(QString gate_name) const;
+    // Optional: only send data matching 'filter' through the output
+    // ... 'gate_name'. Return false if the node cannot apply the filter.
+    virtual bool acceptFilter(QString gate_name, QString filter);
     //***********************************************************
     // Helper functions to ease the life of the Node programmers.
     // **********************************************************
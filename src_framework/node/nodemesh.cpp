@@ -20,6 +20,7 @@ CNodeMesh::CNodeMesh()
     , m_nodes_waiting(0)
     , m_start_success(true)
     , m_nodes_processing(0)
+    , m_output_filters()
 {
 
 }
@@ -62,6 +63,8 @@ bool CNodeMesh::parseMesh(QString json_str)
         }
     }
 
+    pushFilters();
+
     return true;
 }
 
@@ -366,9 +369,48 @@ bool CNodeMesh::addConnection(QVariantMap& connections_json)
         return false;
     }
 
+    // Remember what the destination needs from this output.
+    m_output_filters[qMakePair(src_name, src_gate)]
+            .append(dest_node->inputFilter(dest_gate));
+
     return true;
 }
 
+void CNodeMesh::pushFilters()
+{
+    CLogInfo log;
+
+    QMap<QPair<QString, QString>, QStringList>::iterator i;
+    for(i = m_output_filters.begin(); i != m_output_filters.end(); ++i) {
+        const QString &node_name = i.key().first;
+        const QString &gate_name = i.key().second;
+
+        // An output can only be filtered if every destination filters it.
+        QStringList filters;
+        for(const QString &filter : i.value()) {
+            if(filter.isEmpty()) {
+                filters.clear();
+                break;
+            }
+            filters.append("(" + filter + ")");
+        }
+        if(filters.isEmpty()) {
+            continue;
+        }
+        filters.removeDuplicates();
+
+        QString filter = filters.join(" or ");
+        if(m_nodes[node_name]->acceptFilter(gate_name, filter)) {
+            log.setMsg(QString("Filtering the output '%1' of node '%2' with: %3")
+                       .arg(gate_name, node_name, filter));
+            log.setSrc(CLogInfo::ESource::framework);
+            log.setStatus(CLogInfo::EStatus::info);
+            log.setTime(QDateTime::currentDateTime());
+            log.print();
+        }
+    }
+}
+
 void CNodeMesh::onNodeStarted(bool success)
 {
     // Decrease the nodes that have been started and check if there
@@ -3,6 +3,9 @@
 
 #include "node.h"
 #include <QList>
+#include <QMap>
+#include <QPair>
+#include <QStringList>
 #include <QSharedPointer>
 #include <QObject>
 
@@ -18,6 +21,9 @@ class CNodeMesh: public QObject
     // The number of nodes that are concurrently processing something
     // ... at any point in the lifetime of the mesh.
     quint32 m_nodes_processing;
+    // The input filters of the nodes connected to each output gate, indexed
+    // ... by node and gate name.
+    QMap<QPair<QString, QString>, QStringList> m_output_filters;
 
   public:
     explicit CNodeMesh();
@@ -36,6 +42,9 @@ class CNodeMesh: public QObject
   private:
     bool addNode(QVariantMap &node_json);
     bool addConnection(QVariantMap &connections_json);
+    // Let the nodes filter their outputs when all the nodes connected to
+    // ... an output gate filter their inputs.
+    void pushFilters();
 
   private slots:
     void onNodeStarted(bool success);
@@ -67,7 +67,7 @@ void CCsvdumpNode::dumpIntoFile(const QSharedPointer<const CTableData> &table) {
         const QList<QVariant> &row = dump_table->getRow(j);
         for(qint32 i = 0; i < attribute_count; ++i)
         {
-          QString value  = row[i].toString()+";";
+          QString value  = table->formatValue(i, row[i])+";";
           csv_value = csv_value+value;
         }
         qDebug()<<csv_value;
@@ -0,0 +1,393 @@
+#include "csvparser.h"
+#include <QtConcurrent>
+#include <QAtomicInt>
+#include <QThread>
+#include <QString>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__SSE2__))
+#define CSVPARSER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // The text is split in chunks of about this many bytes.
+    const qint32 CHUNK_SIZE = 1 << 20;
+
+    inline bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    // Find the first ',' or '\n' in [p, end), or 'end' if there is none.
+    const char *findDelimiter(const char *p, const char *end)
+    {
+#ifdef CSVPARSER_SSE2
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i newline = _mm_set1_epi8('\n');
+        for(; end - p >= 16; p += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            qint32 mask = _mm_movemask_epi8(_mm_or_si128(
+                    _mm_cmpeq_epi8(bytes, comma), _mm_cmpeq_epi8(bytes, newline)));
+            if(mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+        }
+#endif
+        while(p < end && *p != ',' && *p != '\n') {
+            ++p;
+        }
+
+        return p;
+    }
+
+    qint32 countQuotes(const char *p, const char *end)
+    {
+        qint32 count = 0;
+#ifdef CSVPARSER_SSE2
+        const __m128i quote = _mm_set1_epi8('"');
+        for(; end - p >= 16; p += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            count += __builtin_popcount(
+                        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote)));
+        }
+#endif
+        for(; p < end; ++p) {
+            count += *p == '"';
+        }
+
+        return count;
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CCsvParser::CCsvParser(const QByteArray &bytes)
+    : m_bytes(bytes)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+bool CCsvParser::parse(CTableData &table, bool headers, bool infer_types) const
+{
+    // Skip the UTF-8 byte order mark.
+    qint32 begin = m_bytes.startsWith("\xef\xbb\xbf") ? 3 : 0;
+
+    if(headers) {
+        if(begin == m_bytes.size()) {
+            return false;
+        }
+        SChunk header;
+        header.begin = begin;
+        header.end = begin + 1;
+        begin = parseRecords(header);
+        QList<QString> attrs;
+        for(const SField &field : header.fields) {
+            attrs.append(text(field));
+        }
+        table.addHeader(attrs);
+    }
+
+    QVector<SChunk> chunks = split(begin);
+    QAtomicInt aligned(1);
+    QtConcurrent::blockingMap(chunks, [&] (SChunk &chunk) {
+        if(parseRecords(chunk) != chunk.end) {
+            // A quote inside an unquoted field made the split go wrong.
+            aligned.store(0);
+        }
+    });
+    if(!aligned.load()) {
+        // Parse everything in one go instead.
+        chunks.resize(1);
+        chunks[0].begin = begin;
+        chunks[0].end = m_bytes.size();
+        chunks[0].fields.clear();
+        chunks[0].records.clear();
+        parseRecords(chunks[0]);
+    }
+
+    // Every column gets the least specific type of its fields.
+    QVector<EType> types;
+    if(infer_types) {
+        QtConcurrent::blockingMap(chunks, [&] (SChunk &chunk) {
+            inferTypes(chunk);
+        });
+        for(const SChunk &chunk : chunks) {
+            if(chunk.types.size() > types.size()) {
+                types.resize(chunk.types.size());
+            }
+            for(qint32 i = 0; i < chunk.types.size(); ++i) {
+                types[i] = qMax(types.at(i), chunk.types.at(i));
+            }
+        }
+    }
+
+    QtConcurrent::blockingMap(chunks, [&] (SChunk &chunk) {
+        createRows(chunk, types);
+    });
+    for(SChunk &chunk : chunks) {
+        table.appendRows(chunk.rows);
+        chunk.rows.clear();
+    }
+
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+// Private Functions
+
+QVector<CCsvParser::SChunk> CCsvParser::split(qint32 begin) const
+{
+    const char *data = m_bytes.constData();
+    const qint32 size = m_bytes.size();
+    qint32 chunk_count = qBound(1, (size - begin) / CHUNK_SIZE,
+                                QThread::idealThreadCount() * 4);
+    qint32 chunk_size = (size - begin + chunk_count - 1) / chunk_count;
+
+    QVector<SChunk> chunks(chunk_count);
+    for(qint32 i = 0; i < chunk_count; ++i) {
+        chunks[i].begin = qMin(begin + i * chunk_size, size);
+        chunks[i].end = qMin(chunks[i].begin + chunk_size, size);
+    }
+    if(chunk_count == 1) {
+        return chunks;
+    }
+
+    QtConcurrent::blockingMap(chunks, [&] (SChunk &chunk) {
+        chunk.quotes = countQuotes(data + chunk.begin, data + chunk.end);
+    });
+
+    // A line break ends a record if the number of quotes before it is even.
+    // ... Move the beginning of every chunk after the first such line break.
+    qint32 quotes = 0;
+    for(SChunk &chunk : chunks) {
+        qint32 chunk_quotes = chunk.quotes;
+        chunk.quotes = quotes;
+        quotes += chunk_quotes;
+    }
+    QtConcurrent::blockingMap(chunks, [&] (SChunk &chunk) {
+        if(chunk.begin == begin) {
+            return;
+        }
+        bool quoted = chunk.quotes & 1;
+        for(qint32 i = chunk.begin; i < chunk.end; ++i) {
+            if(data[i] == '"') {
+                quoted = !quoted;
+            }
+            else if(data[i] == '\n' && !quoted) {
+                chunk.begin = i + 1;
+                return;
+            }
+        }
+        // The chunk is inside a single record.
+        chunk.begin = -1;
+    });
+
+    qint32 next = size;
+    for(qint32 i = chunk_count - 1; i >= 0; --i) {
+        if(chunks[i].begin < 0) {
+            chunks[i].begin = next;
+        }
+        chunks[i].end = next;
+        next = chunks[i].begin;
+    }
+
+    return chunks;
+}
+
+qint32 CCsvParser::parseRecords(SChunk &chunk) const
+{
+    const char *data = m_bytes.constData();
+    const char *end = data + m_bytes.size();
+    const char *p = data + chunk.begin;
+
+    while(p < data + chunk.end) {
+        while(true) {
+            SField field;
+            if(p < end && *p == '"') {
+                // Find the closing quote, skipping the doubled ones.
+                const char *q = p + 1;
+                while(true) {
+                    q = static_cast<const char *>(std::memchr(q, '"', end - q));
+                    if(q == nullptr) {
+                        q = end;
+                        break;
+                    }
+                    if(q + 1 < end && q[1] == '"') {
+                        q += 2;
+                        continue;
+                    }
+                    break;
+                }
+                field.offset = p + 1 - data;
+                field.length = q - p - 1;
+                field.quoted = true;
+                // Ignore anything between the closing quote and the delimiter.
+                p = findDelimiter(q == end ? end : q + 1, end);
+            }
+            else {
+                const char *q = findDelimiter(p, end);
+                field.offset = p - data;
+                field.length = q - p;
+                field.quoted = false;
+                if((q == end || *q == '\n') && field.length > 0 &&
+                   q[-1] == '\r') {
+                    // A CRLF line break, also at the end of the last line.
+                    --field.length;
+                }
+                p = q;
+            }
+            chunk.fields.append(field);
+
+            if(p == end) {
+                break;
+            }
+            if(*p++ == '\n') {
+                break;
+            }
+        }
+        chunk.records.append(chunk.fields.size());
+    }
+
+    return p - data;
+}
+
+void CCsvParser::inferTypes(SChunk &chunk) const
+{
+    qint32 field = 0;
+    for(qint32 record_end : chunk.records) {
+        if(record_end - field > chunk.types.size()) {
+            chunk.types.resize(record_end - field);
+        }
+        for(qint32 column = 0; field < record_end; ++field, ++column) {
+            EType &column_type = chunk.types[column];
+            if(column_type != EType::text) {
+                column_type = qMax(column_type, type(chunk.fields.at(field)));
+            }
+        }
+    }
+}
+
+void CCsvParser::createRows(SChunk &chunk, const QVector<EType> &types) const
+{
+    qint32 field = 0;
+    for(qint32 record_end : chunk.records) {
+        QList<QVariant> row;
+        row.reserve(record_end - field);
+        for(qint32 column = 0; field < record_end; ++field, ++column) {
+            EType column_type = column < types.size() ?
+                        types.at(column) : EType::text;
+            row.append(value(chunk.fields.at(field), column_type));
+        }
+        chunk.rows.append(row);
+    }
+
+    chunk.fields.clear();
+    chunk.fields.squeeze();
+    chunk.records.clear();
+    chunk.records.squeeze();
+}
+
+QString CCsvParser::text(const SField &field) const
+{
+    QString text = QString::fromUtf8(m_bytes.constData() + field.offset,
+                                     field.length);
+    if(field.quoted) {
+        text.replace(QLatin1String("\"\""), QLatin1String("\""));
+    }
+
+    return text;
+}
+
+CCsvParser::EType CCsvParser::type(const SField &field) const
+{
+    if(field.quoted) {
+        return EType::text;
+    }
+    if(field.length == 0) {
+        return EType::empty;
+    }
+
+    const char *p = m_bytes.constData() + field.offset;
+    const char *end = p + field.length;
+    if(*p == '-' || *p == '+') {
+        ++p;
+    }
+    const char *integer = p;
+    while(p < end && isDigit(*p)) {
+        ++p;
+    }
+    qint32 integer_digits = p - integer;
+    // Numbers with leading zeros are kept as text (e.g., padded octets).
+    if(integer_digits > 1 && *integer == '0') {
+        return EType::text;
+    }
+    if(p == end) {
+        // At most 18 digits always fit in a qint64.
+        return integer_digits > 0 && integer_digits <= 18 ?
+                    EType::integer : EType::text;
+    }
+
+    qint32 fraction_digits = 0;
+    if(*p == '.') {
+        const char *fraction = ++p;
+        while(p < end && isDigit(*p)) {
+            ++p;
+        }
+        fraction_digits = p - fraction;
+    }
+    if(integer_digits + fraction_digits == 0) {
+        return EType::text;
+    }
+    if(p < end && (*p == 'e' || *p == 'E')) {
+        if(++p < end && (*p == '-' || *p == '+')) {
+            ++p;
+        }
+        const char *exponent = p;
+        while(p < end && isDigit(*p)) {
+            ++p;
+        }
+        if(p == exponent) {
+            return EType::text;
+        }
+    }
+
+    return p == end ? EType::real : EType::text;
+}
+
+QVariant CCsvParser::value(const SField &field, EType column_type) const
+{
+    const char *p = m_bytes.constData() + field.offset;
+
+    switch(column_type) {
+    case EType::integer: {
+        if(field.length == 0) {
+            return QVariant();
+        }
+        const char *end = p + field.length;
+        bool negative = *p == '-';
+        if(*p == '-' || *p == '+') {
+            ++p;
+        }
+        qint64 value = 0;
+        for(; p < end; ++p) {
+            value = value * 10 + (*p - '0');
+        }
+        return QVariant(static_cast<qlonglong>(negative ? -value : value));
+    }
+    case EType::real:
+        if(field.length == 0) {
+            return QVariant();
+        }
+        return QVariant(QByteArray::fromRawData(p, field.length).toDouble());
+    default:
+        return QVariant(text(field));
+    }
+}
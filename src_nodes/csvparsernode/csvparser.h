@@ -0,0 +1,61 @@
+#ifndef CSVPARSER_H
+#define CSVPARSER_H
+
+#include "tabledata/tabledata.h"
+#include <QByteArray>
+#include <QVector>
+#include <QList>
+#include <QVariant>
+
+
+// Parser of comma separated values. Fields may be quoted with '"' (quotes
+// ... inside them are doubled) and quoted fields may span several lines.
+// ... The text is split in chunks at line breaks outside quoted fields,
+// ... found from the parity of the quotes before them, and the chunks are
+// ... parsed in parallel.
+class CCsvParser
+{
+  private:
+    // The types a column can have, from the most to the least specific.
+    enum class EType {empty, integer, real, text};
+    // Where a field is in the text.
+    struct SField {
+        qint32 offset;
+        qint32 length;
+        bool quoted;
+    };
+    // The records that begin in [begin, end): their fields, the index in
+    // ... 'fields' where each record ends and the types of the columns.
+    struct SChunk {
+        qint32 begin;
+        qint32 end;
+        qint32 quotes;
+        QVector<SField> fields;
+        QVector<qint32> records;
+        QVector<EType> types;
+        QList<QList<QVariant>> rows;
+    };
+
+    const QByteArray &m_bytes;
+
+  public:
+    explicit CCsvParser(const QByteArray &bytes);
+    // Add the records to 'table', the first one as the header if 'headers'
+    // ... is set. Return false if a header is requested but there is none.
+    // ... With 'infer_types' the columns with only integers or only numbers
+    // ... get qint64 or double values instead of strings.
+    bool parse(CTableData &table, bool headers, bool infer_types) const;
+
+  private:
+    // Split the text after 'begin' in chunks made of whole records.
+    QVector<SChunk> split(qint32 begin) const;
+    // Parse the records of 'chunk'. Return where the last record ends.
+    qint32 parseRecords(SChunk &chunk) const;
+    void inferTypes(SChunk &chunk) const;
+    void createRows(SChunk &chunk, const QVector<EType> &types) const;
+    QString text(const SField &field) const;
+    EType type(const SField &field) const;
+    QVariant value(const SField &field, EType column_type) const;
+};
+
+#endif // CSVPARSER_H
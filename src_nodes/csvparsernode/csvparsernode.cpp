@@ -4,6 +4,7 @@
 #include "csvdumpdata/csvdumpdata.h"
 #include "tabledata/tabledata.h"
 #include "filedata/filedata.h"
+#include "csvparser.h"
 #include <QDebug>
 #include <QFile>
 #include <QSharedPointer>
@@ -29,6 +30,9 @@ void CCsvparserNode::configure(CNodeConfig &config)
     // Add parameters
     config.addBool("headers", "Headers Included",
         "Are the headers included in the CSV file?", false);
+    config.addBool("infer_types", "Infer Column Types",
+        "Store the columns with only integers or only numbers as numbers "
+        "instead of strings.", false);
     config.setCategory("Parser");
     // Add the gates.
     config.addInput("in", "file");
@@ -55,7 +59,6 @@ bool CCsvparserNode::data(QString gate_name, const CConstDataPointer &data)
 
     // Interpret the received data as a file and get the bytes of the file.
     QSharedPointer<const CFileData> file = data.staticCast<const CFileData>();
-    QTextStream file_bytes(file->getBytes());
 
     // Have we received a text file?
     if(file->isDataBinary()) {
@@ -65,46 +68,16 @@ bool CCsvparserNode::data(QString gate_name, const CConstDataPointer &data)
 
     // Get the user parameters.
     bool headers = getConfig().getParameter("headers")->value.toBool();
+    bool infer_types = getConfig().getParameter("infer_types")->value.toBool();
 
-    // Create a table that will contain
-    QSharedPointer<CTableData> csv_table;
-    if(!createDataTable(csv_table, file_bytes, headers)) {
+    // Parse the records of the file into a table.
+    QSharedPointer<CTableData> csv_table = autoCreateData<CTableData>("table");
+    CCsvParser parser(file->getBytes());
+    if(!parser.parse(*csv_table, headers, infer_types)) {
         commitError("out", "Could not create table.");
         return true;
     }
 
-    // Parse each line of the file.
-    while(!file_bytes.atEnd()) {
-        QString line = file_bytes.readLine();
-        QStringList entries = line.split(',');
-        QList<QVariant> &row = csv_table->newRow();
-        for(int i = 0; i < entries.length(); ++i) {
-            row.append(entries.at(i));
-        }
-    }
-
     commit("out", csv_table);
     return true;
 }
-
-bool CCsvparserNode::createDataTable(
-    QSharedPointer<CTableData> &table,
-    QTextStream &file_bytes,
-    bool headers)
-{
-    table = autoCreateData<CTableData>("table");
-
-    // Set the headers if there are any.
-    if(headers) {
-        if(!file_bytes.atEnd()) {
-            QString line = file_bytes.readLine();
-            QStringList entries = line.split(',');
-            table->addHeader(entries);
-        } else {
-            // Could not parse headers.
-            return false;
-        }
-    }
-
-    return true;
-}
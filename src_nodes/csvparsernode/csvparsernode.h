@@ -8,7 +8,6 @@
 
 #include <QObject>
 #include <QString>
-#include <QTextStream>
 
 class CCsvparserNode: public CNode
 {
@@ -31,10 +30,6 @@ class CCsvparserNode: public CNode
     //Parse Data into a *.csv file
     //void parseIntoCSV(const QSharedPointer<const CTableData> &table);
 
-  private:
-    bool createDataTable(QSharedPointer<CTableData> &table,
-        QTextStream &file_bytes, bool header);
-
 };
 
 #endif // CSVPARSERNODE_H
@@ -1,4 +1,5 @@
 QT += core
+QT += concurrent
 QT -= gui
 
 TARGET = csvparsernode
@@ -29,9 +30,11 @@ QMAKE_CLEAN += $$DESTDIR/*$$TARGET*
 
 HEADERS += \
     csvparsernode.h \
+    csvparser.h \
     interface.h
 
 SOURCES += \
     csvparsernode.cpp \
+    csvparser.cpp \
     interface.cpp
 
@@ -2,9 +2,169 @@
 #include "data/datafactory.h"
 #include "data/messagedata.h"
 #include "tabledata/tabledata.h"
+#include "valuebitmaps.h"
+#include "philox.h"
+#include "rulesetdata/rulesetfile.h"
+#include "rulesetdata/uniquetuples.h"
 #include <QDebug>
 #include <QList>
+#include <QVector>
+#include <QPair>
 #include <QFile>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+    // Rules and pairs of tuples are given to the threads in ranges of this
+    // ... size.
+    const qint32 RANGE_SIZE = 16;
+    // The random number streams of the samples and of the pairs of tuples.
+    // ... Each pair has a substream of its own.
+    const quint32 SAMPLES_STREAM = 0;
+    const quint32 PAIRS_STREAM = 1;
+    // The samples stream has a substream for each block of this many tuples.
+    const qint32 SAMPLES_BLOCK = 1024;
+
+    // Run 'function' on ranges of [0, count) spread among the threads.
+    template<typename F>
+    void forRanges(qint32 count, F function)
+    {
+        QVector<QPair<qint32, qint32>> ranges;
+        for(qint32 i = 0; i < count; i += RANGE_SIZE) {
+            ranges.append(qMakePair(i, qMin(i + RANGE_SIZE, count)));
+        }
+        QtConcurrent::blockingMap(ranges, function);
+    }
+
+    // Call 'function' with the index of every bit set in 'words' until it
+    // ... returns false.
+    template<typename F>
+    void forEachBit(const quint64 *words, qint32 word_count, F function)
+    {
+        for(qint32 w = 0; w < word_count; ++w) {
+            quint64 bits = words[w];
+            while(bits != 0) {
+                if(!function(w * 64 + __builtin_ctzll(bits))) {
+                    return;
+                }
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    // Pointers to the rules, which stay valid while the list is not changed.
+    QVector<CRule *> rulePointers(QList<CRule> &ruleset)
+    {
+        QVector<CRule *> rules;
+        rules.reserve(ruleset.size());
+        for(CRule &rule : ruleset) {
+            rules.append(&rule);
+        }
+        return rules;
+    }
+
+    // Get the bitmap slots of the values each rule constrains. When
+    // ... estimating the support of the samples all the constrained values
+    // ... are checked, matchAntecedents() only checks the ones in
+    // ... i_antecedents.
+    QVector<QVector<qint32>> ruleSlots(const QVector<CRule *> &rules,
+                                       bool all_constraints,
+                                       CValueBitmaps &bitmaps)
+    {
+        QVector<QVector<qint32>> rule_slots(rules.size());
+        for(qint32 i = 0; i < rules.size(); ++i) {
+            const CRule &rule = *rules.at(i);
+            if(all_constraints) {
+                for(qint32 j = 0; j < rule.antecedent.size(); ++j) {
+                    if(rule.antecedent[j] >= 2) {
+                        rule_slots[i].append(bitmaps.slot(j, rule.antecedent[j]));
+                    }
+                }
+            }
+            else {
+                for(qint32 j : rule.i_antecedents) {
+                    rule_slots[i].append(bitmaps.slot(j, rule.antecedent[j]));
+                }
+            }
+        }
+        return rule_slots;
+    }
+
+    // Remove the rules not marked in 'keep', preserving the order of the rest.
+    void compactRules(QList<CRule> &ruleset, const QVector<bool> &keep)
+    {
+        QList<CRule> kept;
+        kept.reserve(ruleset.size());
+        for(qint32 i = 0; i < ruleset.size(); ++i) {
+            if(keep.at(i)) {
+                kept.append(ruleset.at(i));
+            }
+        }
+        ruleset.swap(kept);
+    }
+
+    // Count the tuples in which every attribute is predicted by at least one
+    // ... rule. The distinct tuples are indexed by blocks, which go through
+    // ... all the rules in parallel.
+    QVector<qint64> coverage(const CUniqueTuples &unique, QList<CRule> &ruleset,
+                             qint32 attribute_count)
+    {
+        QVector<CRule *> rules = rulePointers(ruleset);
+        CValueBitmaps index(attribute_count);
+        QVector<QVector<qint32>> rule_slots = ruleSlots(rules, false, index);
+
+        const qint32 block_size = 16384;
+        QVector<QPair<qint32, qint32>> blocks;
+        for(qint32 i = 0; i < unique.size(); i += block_size) {
+            blocks.append(qMakePair(i, qMin(i + block_size, unique.size())));
+        }
+        QVector<QVector<qint64>> block_counts(blocks.size());
+        QVector<qint64> *block_counts_data = block_counts.data();
+        QtConcurrent::blockingMap(blocks, [&] (const QPair<qint32, qint32> &block) {
+            CValueBitmaps bitmaps = index;
+            bitmaps.build(unique.tuples(), block.first, block.second - block.first);
+            qint32 words = bitmaps.wordCount();
+
+            // The tuples of the block predicted for every attribute.
+            QVector<quint64> match(words);
+            QVector<quint64> covered(attribute_count * words, 0);
+            for(qint32 i = 0; i < rules.size(); ++i) {
+                bitmaps.match(rule_slots.at(i), match.data());
+                quint64 *predicted = covered.data() +
+                        rules.at(i)->i_consequent * words;
+                for(qint32 w = 0; w < words; ++w) {
+                    predicted[w] |= match.at(w);
+                }
+            }
+
+            QVector<qint64> &counts = block_counts_data[block.first / block_size];
+            counts.fill(0, attribute_count);
+            for(qint32 j = 0; j < attribute_count; ++j) {
+                forEachBit(covered.constData() + j * words, words, [&] (qint32 k) {
+                    counts[j] += unique.weight(block.first + k);
+                    return true;
+                });
+            }
+        });
+
+        QVector<qint64> counts(attribute_count, 0);
+        for(const QVector<qint64> &block : block_counts) {
+            for(qint32 j = 0; j < attribute_count; ++j) {
+                counts[j] += block.at(j);
+            }
+        }
+        return counts;
+    }
+
+    // A horizontal partition of the dataset and the rules trained on it.
+    struct SPartition {
+        qint32 first;
+        qint32 count;
+        quint64 seed;
+        CRulesetData ruleset;
+    };
+}
 
 
 //------------------------------------------------------------------------------
@@ -34,7 +194,7 @@ void CLeradNode::configure(CNodeConfig &config)
     config.addUInt("rseed", "Random Seed", "The random seed to feed the "
                    "random number generator at the start.", 666);
     config.addUInt("sample_size", "Training Samples", "Number of samples to use "
-                   "for training LERAD.", 100);
+                   "for training LERAD (at least 2).", 100);
     config.addUInt("pairs_to_match", "Number of Pairs to Match",
                    "Number of pairs to match for building rules", 1000);
     config.addUInt("max_rules_per_pair", "Maximum Rules per Pair",
@@ -43,6 +203,20 @@ void CLeradNode::configure(CNodeConfig &config)
                    "generated by LERAD to a file.", false);
     config.addFilename("rules_file", "Rules Filename", "File where the "
                        "LERAD rules are written.");
+    config.addBool("save_model", "Save the Model", "Write the ruleset to a "
+                   "binary file that the rulesetload node can read.", false);
+    config.addFilename("model_file", "Model Filename", "File where the "
+                       "binary ruleset is written.");
+    config.addUInt("partitions", "Partitions", "Split the table in this "
+                   "many consecutive partitions, train on them in parallel "
+                   "and merge their rules. The support of the merged "
+                   "rules is calculated again on the whole table.", 1);
+    config.addBool("prune_rules", "Prune the Rules", "Remove the duplicated "
+                   "rules and the rules that only fire when a more general "
+                   "rule with the same or better n/r fires.", false);
+    config.addUInt("max_rules", "Maximum Rules", "Keep at most this many "
+                   "rules with the best n/r when pruning (0 keeps them all).",
+                   0);
 
     // Add the gates.
     config.addInput("in", "table");
@@ -55,6 +229,12 @@ void CLeradNode::configure(CNodeConfig &config)
 
 bool CLeradNode::start()
 {
+    // Rules are built by matching pairs of different samples.
+    if(getConfig().getParameter("sample_size")->value.toUInt() < 2) {
+        logError("LERAD needs at least 2 training samples.");
+        return false;
+    }
+
     m_ruleset = QSharedPointer<CRulesetData>(
         static_cast<CRulesetData *>(createData("ruleset")));
 
@@ -90,11 +270,12 @@ void CLeradNode::lerad(const QSharedPointer<const CTableData> &table)
     QString info;
     QString warning;
     // Seed the algorithm.
-    qsrand(getConfig().getParameter("rseed")->value.toUInt());
+    quint64 seed = getConfig().getParameter("rseed")->value.toUInt();
 
-    // Helpers for translating nominals to strings and viceversa.
-    qint32 anything_nominal = m_ruleset->string2nominal("*");
-    qint32 something_nominal = m_ruleset->string2nominal("?");
+    // Helpers for translating nominals to strings and viceversa. The
+    // ... nominals 0 and 1 are "*" and "?".
+    m_ruleset->string2nominal("*");
+    m_ruleset->string2nominal("?");
 
     // Number of attributes
     qint32 attribute_count = table->colCount();
@@ -106,48 +287,162 @@ void CLeradNode::lerad(const QSharedPointer<const CTableData> &table)
     }
     m_ruleset->attributeCount(attribute_count);
 
-    // 2- Read tuples from the table to build a dataset.
-    QList<QList<Nominal>> dataset;
-
-    qint32 rows = table->rowCount();
-    for(qint32 j = 0; j < rows; ++j) {
+    // 2- Read tuples from the table to build a dataset. The dataset is a
+    // ... row-major matrix with a column per attribute.
+    qint32 tuple_count = table->rowCount();
+    QVector<Nominal> dataset;
+    dataset.reserve(tuple_count * attribute_count);
+    for(qint32 j = 0; j < tuple_count; ++j) {
         // Get the row.
         const QList<QVariant> &row = table->getRow(j);
-        //qDebug()<<"number of rows ::"<<row;
-        // Iterate the attributes of the row.
-        Antecedent t;
-        t.reserve(attribute_count);
-
-        //qDebug() << "DATE TIME DEST_IP DEST_PORT SRC_IP SRC_PORT DUR F1 F2 F3 LEN W1 ... W8";
         for(qint32 i = 0; i < attribute_count; ++i) {
             // Convert attribute to nominal.
-            QString attr = row[i].toString();
-            qint32 n = m_ruleset->string2nominal(attr);
-            t.append(n);
+            dataset.append(m_ruleset->string2nominal(row[i].toString()));
         }
-        dataset.append(t);
     }
-    m_ruleset->tuplesCount(dataset.size());
-    info = "Dataset size: " + QVariant(dataset.size()).toString();
+    const Nominal *tuples = dataset.constData();
+    m_ruleset->tuplesCount(tuple_count);
+    info = "Dataset size: " + QVariant(tuple_count).toString();
     logInfo(info);
 
-    if(dataset.size() < 2) {
+    if(tuple_count < 2) {
         warning = "Cannot work with less than two tuples.";
         logWarning(warning);
         return;
     }
 
+    // Train on each partition of the dataset and merge their rules. Every
+    // ... partition needs at least two tuples.
+    qint32 partition_count =
+            getConfig().getParameter("partitions")->value.toInt();
+    partition_count = qBound(1, partition_count, tuple_count / 2);
+    if(partition_count == 1) {
+        train(tuples, tuple_count, seed, *m_ruleset, true);
+    }
+    else {
+        QVector<SPartition> partitions;
+        for(qint32 p = 0; p < partition_count; ++p) {
+            SPartition partition;
+            qint64 first = static_cast<qint64>(tuple_count) * p;
+            partition.first = first / partition_count;
+            partition.count = (first + tuple_count) / partition_count -
+                    partition.first;
+            partition.seed = seed + p;
+            // Start with the dictionary of the whole dataset.
+            partition.ruleset = *m_ruleset;
+            partitions.append(partition);
+        }
+
+        QtConcurrent::blockingMap(partitions, [&] (SPartition &partition) {
+            train(tuples + partition.first * attribute_count, partition.count,
+                  partition.seed, partition.ruleset, false);
+        });
+
+        m_ruleset->tuplesCount(0);
+        for(const SPartition &partition : partitions) {
+            m_ruleset->merge(partition.ruleset);
+        }
+        info = "Merged Rules: " + QVariant(m_ruleset->size()).toString() +
+                " from " + QVariant(partition_count).toString() + " partitions";
+        logInfo(info);
+
+        // The merged support is only the sum of the partitions, which loses
+        // ... the time of the last new value and the false positives of the
+        // ... validation tuples. Calculate it again on the whole dataset.
+        m_ruleset->tuplesCount(tuple_count);
+        support(tuples, tuple_count, *m_ruleset, true);
+        info = "Supported Rules: " + QVariant(m_ruleset->size()).toString();
+        logInfo(info);
+    }
+
+    // Shall we remove the rules that add little to the others?
+    bool prune_rules = getConfig().getParameter("prune_rules")->value.toBool();
+    if(prune_rules) {
+        // Compare the tuples each attribute is predicted in before and after.
+        CUniqueTuples unique;
+        unique.build(tuples, tuple_count, attribute_count);
+        QVector<qint64> coverage_before =
+                coverage(unique, m_ruleset->getRules(), attribute_count);
+
+        qint32 max_rules = getConfig().getParameter("max_rules")->value.toInt();
+        SPruneReport report = m_ruleset->prune(max_rules);
+        info = QString("Removed %1 duplicated, %2 dominated and %3 capped "
+                       "rules, %4 rules left.")
+                .arg(report.duplicates).arg(report.dominated)
+                .arg(report.capped).arg(m_ruleset->size());
+        logInfo(info);
+
+        QVector<qint64> coverage_after =
+                coverage(unique, m_ruleset->getRules(), attribute_count);
+        logCoverage(table->header(), coverage_before, coverage_after);
+    }
+
+    // Shall we write the rules to a file?
+    bool dump_rules = getConfig().getParameter("dump_rules")->value.toBool();
+    if(dump_rules) {
+        QString filename = getConfig().getParameter("rules_file")->value.toString();
+        dumpRules(table->header(), filename);
+    }
+
+    // Shall we save the ruleset to be evaluated later?
+    bool save_model = getConfig().getParameter("save_model")->value.toBool();
+    if(save_model) {
+        QString filename = getConfig().getParameter("model_file")->value.toString();
+        if(!CRulesetFile::save(*m_ruleset, filename)) {
+            warning = "Could not write the ruleset to " + filename;
+            logWarning(warning);
+        }
+    }
+
+    // Forward the ruleset.
+    commit("out", m_ruleset);
+    // Free memory when possible.
+    m_ruleset.clear();
+}
+
+void CLeradNode::train(const Nominal *tuples, qint32 tuple_count, quint64 seed,
+                       CRulesetData &ruleset_data, bool report)
+{
+    QString info;
+    qint32 attribute_count = ruleset_data.attributeCount();
+    qint32 anything_nominal = ruleset_data.string2nominal("*");
+    qint32 something_nominal = ruleset_data.string2nominal("?");
+    ruleset_data.tuplesCount(tuple_count);
+
     // 3- Select random samples from the dataset for preliminary training.
     qint32 sample_size = getConfig().getParameter("sample_size")->value.toInt();
     QList<qint32> samples;
     samples.reserve(sample_size);
 
-    qint32 r = qMin(dataset.size(), sample_size);
-    for(qint32 i = 0; r > 0 && i < dataset.size(); ++i) {
-        qint32 rand_num = rnd() % (dataset.size() - i);
-        if(rand_num < r) {
-            --r;
-            samples.append(i);
+    // Every tuple gets a random key and the tuples with the smallest keys
+    // ... are taken. The index in the low bits breaks ties.
+    qint32 r = qMin(tuple_count, sample_size);
+    QVector<quint64> keys(tuple_count);
+    quint64 *keys_data = keys.data();
+    qint32 block_count = (tuple_count + SAMPLES_BLOCK - 1) / SAMPLES_BLOCK;
+    forRanges(block_count, [&] (const QPair<qint32, qint32> &range) {
+        for(qint32 block = range.first; block < range.second; ++block) {
+            CPhilox random(seed, SAMPLES_STREAM, block);
+            qint32 last = qMin((block + 1) * SAMPLES_BLOCK, tuple_count);
+            for(qint32 i = block * SAMPLES_BLOCK; i < last; ++i) {
+                keys_data[i] = (static_cast<quint64>(random.next()) << 32) | i;
+            }
+        }
+    });
+    std::nth_element(keys.begin(), keys.begin() + r - 1, keys.end());
+    for(qint32 i = 0; i < r; ++i) {
+        samples.append(static_cast<qint32>(keys.at(i) & 0xffffffff));
+    }
+    std::sort(samples.begin(), samples.end());
+    keys.clear();
+
+    // Copy the samples to a matrix of their own.
+    QVector<Nominal> sample_tuples;
+    sample_tuples.reserve(samples.size() * attribute_count);
+    for(qint32 sample : samples) {
+        const Nominal *tuple = tuples + sample * attribute_count;
+        for(qint32 j = 0; j < attribute_count; ++j) {
+            sample_tuples.append(tuple[j]);
         }
     }
 
@@ -163,190 +458,252 @@ void CLeradNode::lerad(const QSharedPointer<const CTableData> &table)
     qint32 max_rules = getConfig().
             getParameter("max_rules_per_pair")->value.toInt();
 
-    m_ruleset->reserve(ruleset_size * max_rules * 0.85);
-
-    Antecedent antecedent;
-    antecedent.reserve(attribute_count);
-    for(qint32 j = 0; j < attribute_count; ++j) {
-        antecedent.append(anything_nominal);
-    }
-
-    for(qint32 i = 0; i < ruleset_size; ++i) {
-        // Pick random pair of tuples from sample set.
-        qint32 r1 = rnd() % samples.size();
-        qint32 r2 = rnd() % (samples.size() - 1);
-        if(r1 == r2) r2 = samples.size() - 1;
-        r1 = samples[r1];
-        r2 = samples[r2];
+    ruleset_data.reserve(ruleset_size * max_rules * 0.85);
 
-        // Generate rules by matching attribute values.
+    // The pairs are matched in parallel, each one with its own random
+    // ... substream, and their rules are added in the order of the pairs.
+    QVector<QList<Antecedent>> pair_rules(ruleset_size);
+    QList<Antecedent> *pair_rules_data = pair_rules.data();
+    forRanges(ruleset_size, [&] (const QPair<qint32, qint32> &range) {
+        Antecedent antecedent;
+        antecedent.reserve(attribute_count);
         for(qint32 j = 0; j < attribute_count; ++j) {
-            antecedent[j] = anything_nominal;
+            antecedent.append(anything_nominal);
         }
 
-        qint32 count = 0;
-
-        for(qint32 j = 0; j < attribute_count && count < max_rules; ++j) {
-            qint32 r3 = rnd() % attribute_count;
-            if(dataset[r1][r3] == dataset[r2][r3]) {
-                if(count == 0) {
-                    // The first match becomes an consequent (marked with a '?').
-                    antecedent[r3] = something_nominal; // == "?";
-                    count = 1;
-                    // Insert the rule into the ruleset.
-                    m_ruleset->addRule(antecedent);
-                }
-                else if(antecedent[r3] == anything_nominal) {
-                    // Other matches are antecedents
-                    antecedent[r3] = dataset[r1][r3];
-                    ++count;
-                    // Add new rule.
-                    m_ruleset->addRule(antecedent);
+        for(qint32 i = range.first; i < range.second; ++i) {
+            CPhilox random(seed, PAIRS_STREAM, i);
+            // Pick random pair of tuples from sample set.
+            qint32 r1 = random.bounded(samples.size());
+            qint32 r2 = random.bounded(samples.size() - 1);
+            if(r1 == r2) r2 = samples.size() - 1;
+            const Nominal *tuple1 = tuples + samples[r1] * attribute_count;
+            const Nominal *tuple2 = tuples + samples[r2] * attribute_count;
+
+            // Generate rules by matching attribute values.
+            for(qint32 j = 0; j < attribute_count; ++j) {
+                antecedent[j] = anything_nominal;
+            }
+
+            qint32 count = 0;
+
+            for(qint32 j = 0; j < attribute_count && count < max_rules; ++j) {
+                qint32 r3 = random.bounded(attribute_count);
+                if(tuple1[r3] == tuple2[r3]) {
+                    if(count == 0) {
+                        // The first match becomes an consequent (a '?').
+                        antecedent[r3] = something_nominal; // == "?";
+                        count = 1;
+                        // Insert the rule into the ruleset.
+                        pair_rules_data[i].append(antecedent);
+                    }
+                    else if(antecedent[r3] == anything_nominal) {
+                        // Other matches are antecedents
+                        antecedent[r3] = tuple1[r3];
+                        ++count;
+                        // Add new rule.
+                        pair_rules_data[i].append(antecedent);
+                    }
                 }
             }
         }
+    });
+    for(QList<Antecedent> &rules : pair_rules) {
+        for(Antecedent &rule : rules) {
+            ruleset_data.addRule(rule);
+        }
+    }
+    pair_rules.clear();
+    if(report) {
+        info = "Initial Rules: " + QVariant(ruleset_data.size()).toString();
+        logInfo(info);
     }
-    info = "Initial Rules: " + QVariant(m_ruleset->size()).toString();
-    logInfo(info);
 
-    // 5- Estimate the support of each rule using the samples.
-    QList<CRule> &ruleset = m_ruleset->getRules();
-    QList<CRule>::iterator it;
-    for(it = ruleset.begin(); it != ruleset.end(); ++it) {
-        qint32 i = 0;
-        for(; i < samples.size(); ++i) {
-            qint32 r = samples[i];
-            qint32 j = 0;
-            for(; j < attribute_count; ++j) {
-                // Check if the rule applies.
-                if((*it).antecedent[j] >= 2 &&
-                        (*it).antecedent[j] != dataset[r][j]) {
-                    break;
-                }
+    // 5- Estimate the support of each rule using the samples. Every rule
+    // ... is matched against all the samples at once by ANDing the bitmaps
+    // ... of the values it constrains.
+    QList<CRule> &ruleset = ruleset_data.getRules();
+    QVector<CRule *> rules = rulePointers(ruleset);
+    {
+        CValueBitmaps bitmaps(attribute_count);
+        QVector<QVector<qint32>> rule_slots = ruleSlots(rules, true, bitmaps);
+        bitmaps.build(sample_tuples.constData(), 0, samples.size());
+
+        forRanges(rules.size(), [&] (const QPair<qint32, qint32> &range) {
+            QVector<quint64> match(bitmaps.wordCount());
+            for(qint32 i = range.first; i < range.second; ++i) {
+                CRule &rule = *rules.at(i);
+                bitmaps.match(rule_slots.at(i), match.data());
+                forEachBit(match.constData(), match.size(), [&] (qint32 k) {
+                    rule.consequent.add(
+                        sample_tuples.at(k * attribute_count + rule.i_consequent));
+                    return true;
+                });
             }
-            if(j == attribute_count) {
-                // The rule does apply.
-                (*it).consequent.add(dataset[r][(*it).i_consequent]);
-            }
-        }
+        });
     }
 
     // 6- Estimate n/r again so that each tuple attribute is predicted by
     // only the rule with the highest n/r from before
     std::sort(ruleset.begin(), ruleset.end());
-
-    QList<QList<bool>> cover;
-    cover.reserve(sample_size);
-    for(qint32 i = 0; i < sample_size; ++i) {
-        QList<bool> tlist;
-        tlist.reserve(attribute_count);
-        for(qint32 j = 0; j < attribute_count; ++j) {
-            tlist.append(false);
-        }
-        cover.append(tlist);
-    }
-
-    // If there is a rule predicting attribute database[sample[i]][j].
-    for(it = ruleset.begin(); it != ruleset.end(); ++it) {
-        CRule &r = *it;
-        r.consequent.clear();
-
-        for(qint32 j = 0; j < sample_size; ++j) {
-            if(!cover[j][r.i_consequent] &&
-               r.matchAntecedents(dataset[samples[j]])) {
-                r.consequent.add(dataset[samples[j]][r.i_consequent]);
-                cover[j][r.i_consequent] = true;
+    rules = rulePointers(ruleset);
+    {
+        CValueBitmaps bitmaps(attribute_count);
+        QVector<QVector<qint32>> rule_slots = ruleSlots(rules, false, bitmaps);
+        bitmaps.build(sample_tuples.constData(), 0, samples.size());
+        qint32 words = bitmaps.wordCount();
+
+        // The samples matched by each rule are found in parallel, the cover
+        // ... has to be updated in the order of the rules.
+        QVector<quint64> matches(rules.size() * words);
+        quint64 *matches_data = matches.data();
+        forRanges(rules.size(), [&] (const QPair<qint32, qint32> &range) {
+            for(qint32 i = range.first; i < range.second; ++i) {
+                bitmaps.match(rule_slots.at(i), matches_data + i * words);
+            }
+        });
+
+        // The samples of each attribute predicted by a rule.
+        QVector<quint64> cover(attribute_count * words, 0);
+        for(qint32 i = 0; i < rules.size(); ++i) {
+            CRule &rule = *rules.at(i);
+            rule.consequent.clear();
+
+            quint64 *covered = cover.data() + rule.i_consequent * words;
+            for(qint32 w = 0; w < words; ++w) {
+                quint64 hits = matches.at(i * words + w) & ~covered[w];
+                covered[w] |= hits;
+                forEachBit(&hits, 1, [&] (qint32 k) {
+                    rule.consequent.add(sample_tuples.at(
+                        (w * 64 + k) * attribute_count + rule.i_consequent));
+                    return true;
+                });
             }
         }
     }
 
     // 6.1- Discard unsupported rules
-    it = ruleset.begin();
-    while(it != ruleset.end()) {
-        if(it->consequent.n == 0) {
-            it = ruleset.erase(it);
-        }
-        else {
-            ++it;
-        }
+    QVector<bool> keep(ruleset.size());
+    for(qint32 i = 0; i < ruleset.size(); ++i) {
+        keep[i] = ruleset.at(i).consequent.n != 0;
     }
-    info = "Pruned Rules: " + QVariant(ruleset.size()).toString();
-    logInfo(info);
-    // 7- Calculate exact support for top rules on entire training set
+    compactRules(ruleset, keep);
+    if(report) {
+        info = "Pruned Rules: " + QVariant(ruleset_data.size()).toString();
+        logInfo(info);
+    }
+
+    // 7- Calculate exact support for top rules on entire training set.
     std::sort(ruleset.begin(), ruleset.end());
-    // Reset the cover.
-    cover.clear();
-    cover.reserve(dataset.size());
-    for(qint32 i = 0; i < dataset.size(); ++i) {
-        QList<bool> tlist;
-        tlist.reserve(attribute_count);
-        for(qint32 j = 0; j < attribute_count; ++j) {
-            tlist.append(false);
+    support(tuples, tuple_count, ruleset_data, report);
+}
+
+void CLeradNode::support(const Nominal *tuples, qint32 tuple_count,
+                         CRulesetData &ruleset_data, bool report)
+{
+    // The tuples are collapsed into the distinct ones, which add as much
+    // ... support as copies they have. They are numbered in the order they
+    // ... first appear, so the first copy of a value that a rule sees is the
+    // ... same as when going through all the tuples. The distinct tuples are
+    // ... indexed by blocks and the rules go through the blocks in parallel.
+    QString info;
+    qint32 attribute_count = ruleset_data.attributeCount();
+    QList<CRule> &ruleset = ruleset_data.getRules();
+    QVector<CRule *> rules = rulePointers(ruleset);
+    CUniqueTuples unique;
+    unique.build(tuples, tuple_count, attribute_count);
+    const Nominal *unique_tuples = unique.tuples();
+    qint32 unique_count = unique.size();
+    if(report) {
+        info = "Distinct tuples: " + QVariant(unique_count).toString();
+        logInfo(info);
+    }
+
+    CValueBitmaps index(attribute_count);
+    QVector<QVector<qint32>> rule_slots = ruleSlots(rules, false, index);
+    for(CRule *rule : rules) {
+        rule->consequent.clear();
+    }
+    // Rules that trigger false positives in the last 10% of the dataset.
+    QVector<bool> keep(rules.size(), true);
+    bool *keep_data = keep.data();
+    qint32 validation_index = tuple_count * 9;
+
+    const qint32 block_size = 16384;
+    const qint32 batch_size = block_size * QThread::idealThreadCount();
+    if(report) {
+        setProgress(0);
+    }
+    for(qint32 batch = 0; batch < unique_count; batch += batch_size) {
+        qint32 batch_end = qMin(batch + batch_size, unique_count);
+        QVector<QPair<qint32, qint32>> ranges;
+        QVector<CValueBitmaps> blocks;
+        for(qint32 i = batch; i < batch_end; i += block_size) {
+            ranges.append(qMakePair(i, qMin(i + block_size, batch_end)));
+            blocks.append(index);
         }
-        cover.append(tlist);
-    }
-
-    qint32 now = 0;
-    qint32 validation_index = dataset.size() * 9;
-    bool rule_deleted = false;
-
-    it = ruleset.begin();
-    while(it != ruleset.end()) {
-        CRule &rule = *it;
-        rule.consequent.clear();
-        now = 0;
-        rule_deleted = false;
-
-        QList<QList<Nominal>>::iterator tuple_it;
-        qint32 tuple_index = 0;
-        for(tuple_it = dataset.begin(), tuple_index = 0;
-                tuple_it != dataset.end();
-                ++tuple_it, ++tuple_index) {
-            QList<Nominal> &tuple = *tuple_it;
-            ++now;
-            if(rule.matchAntecedents(tuple)) {
-                cover[tuple_index][rule.i_consequent] = true;
-                if(rule.consequent.add(tuple[rule.i_consequent]) == 1) {
-                    // Update time.
-                    rule.consequent.t = now;
-                    // Remove rules that trigger False Positives.
-                    if(tuple_index  * 10 > validation_index) {
-                        it = ruleset.erase(it);
-                        rule_deleted = true;
-                        break;
-                    }
+        CValueBitmaps *blocks_data = blocks.data();
+        QtConcurrent::blockingMap(ranges,
+                                  [&] (const QPair<qint32, qint32> &range) {
+            blocks_data[(range.first - batch) / block_size].build(
+                unique_tuples, range.first, range.second - range.first);
+        });
+
+        forRanges(rules.size(), [&] (const QPair<qint32, qint32> &range) {
+            QVector<quint64> match((block_size + 63) / 64);
+            for(qint32 i = range.first; i < range.second; ++i) {
+                CRule &rule = *rules.at(i);
+                for(qint32 b = 0; b < blocks.size() && keep_data[i]; ++b) {
+                    const CValueBitmaps &block = blocks.at(b);
+                    block.match(rule_slots.at(i), match.data());
+                    forEachBit(match.constData(), block.wordCount(),
+                               [&] (qint32 k) {
+                        qint32 u = block.first() + k;
+                        Nominal value = unique_tuples[u * attribute_count +
+                                                      rule.i_consequent];
+                        qint32 weight = unique.weight(u);
+                        if(rule.consequent.add(value, weight) == weight) {
+                            // Update time.
+                            qint32 tuple_index = unique.first(u);
+                            rule.consequent.t = tuple_index + 1;
+                            // Remove rules that trigger False Positives.
+                            if(tuple_index * 10 > validation_index) {
+                                keep_data[i] = false;
+                                return false;
+                            }
+                        }
+                        return true;
+                    });
                 }
             }
-        }
-        if(!rule_deleted) {
-            ++it;
+        });
+        if(report) {
+            setProgress(static_cast<qint64>(batch_end) * 100 / unique_count);
         }
     }
+    compactRules(ruleset, keep);
     std::sort(ruleset.begin(), ruleset.end());
+}
 
-    // Shall we write the rules to a file?
-    bool dump_rules = getConfig().getParameter("dump_rules")->value.toBool();
-    if(dump_rules) {
-        QString filename = getConfig().getParameter("rules_file")->value.toString();
-        dumpRules(table->header(), filename);
+void CLeradNode::logCoverage(const QList<QString> &header,
+                             const QVector<qint64> &before,
+                             const QVector<qint64> &after)
+{
+    qint32 dropped = 0;
+    for(qint32 i = 0; i < before.size(); ++i) {
+        if(after.at(i) >= before.at(i)) {
+            continue;
+        }
+        ++dropped;
+        QString name = i < header.size() ? header.at(i) : QString::number(i);
+        logWarning(QString("Pruning reduced the tuples where %1 is predicted "
+                           "from %2 to %3.")
+                   .arg(name).arg(before.at(i)).arg(after.at(i)));
     }
 
-    // 8- Print coverage
-//    qDebug() << "LERAD:: Coverage:";
-//    for(qint32 i = 0; i < attribute_count; ++i) {
-//        qint32 count = 0;
-//        for(qint32 j = 0; j < cover.size(); ++j) {
-//            if(cover[j][i]) {
-//                ++count;
-//            }
-//        }
-//        qDebug() << "LERAD::" << table->getHeader()[i] << "=" << count << " ";
-//    }
-
-    // Forward the ruleset.
-    commit("out", m_ruleset);
-    // Free memory when possible.
-    m_ruleset.clear();
+    QString info = QString("Coverage kept for %1 of %2 attributes.")
+            .arg(before.size() - dropped).arg(before.size());
+    logInfo(info);
 }
 
 void CLeradNode::dumpRules(const QList<QString> &header,
@@ -36,17 +36,23 @@ class CLeradNode: public CNode
 
     // The LERAD algorithm
     void lerad(const QSharedPointer<const CTableData> &table);
-    inline qint32 rnd() const;
+    // Train rules on 'tuple_count' tuples of the dataset. The ruleset needs
+    // ... the dictionary and the number of attributes. Progress is only
+    // ... reported if 'report' is set.
+    void train(const Nominal *tuples, qint32 tuple_count, quint64 seed,
+               CRulesetData &ruleset_data, bool report);
+    // Calculate the exact support of the rules on 'tuple_count' tuples and
+    // ... remove the ones that find new values in the last 10% of them.
+    void support(const Nominal *tuples, qint32 tuple_count,
+                 CRulesetData &ruleset_data, bool report);
+    // Warn about the attributes predicted in fewer tuples after pruning.
+    void logCoverage(const QList<QString> &header,
+                     const QVector<qint64> &before,
+                     const QVector<qint64> &after);
     // Write rules to a file.
     void dumpRules(const QList<QString> &header,
                    const QString &filename);
 };
 
-qint32 CLeradNode::rnd() const
-{
-    // 30-31 bit random number
-    return (qrand() + (qrand() << 15)) & 0x7fffffff;
-}
-
 #endif // LERADNODE_H
 
@@ -1,4 +1,5 @@
 QT += core
+QT += concurrent
 QT -= gui
 
 TARGET = leradnode
@@ -29,9 +30,13 @@ QMAKE_CLEAN += $$DESTDIR/*$$TARGET*
 
 HEADERS += \
     leradnode.h \
+    valuebitmaps.h \
+    philox.h \
     interface.h
 
 SOURCES += \
     leradnode.cpp \
+    valuebitmaps.cpp \
+    philox.cpp \
     interface.cpp
 
@@ -0,0 +1,54 @@
+#include "philox.h"
+
+namespace {
+    const quint32 MULTIPLIER0 = 0xd2511f53;
+    const quint32 MULTIPLIER1 = 0xcd9e8d57;
+    const quint32 WEYL0 = 0x9e3779b9;
+    const quint32 WEYL1 = 0xbb67ae85;
+    const qint32 ROUNDS = 10;
+}
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CPhilox::CPhilox(quint64 seed, quint32 stream, quint32 substream/* = 0*/)
+    : m_next(4)
+{
+    m_key[0] = static_cast<quint32>(seed);
+    m_key[1] = static_cast<quint32>(seed >> 32);
+    m_counter[0] = 0;
+    m_counter[1] = 0;
+    m_counter[2] = substream;
+    m_counter[3] = stream;
+}
+
+
+//------------------------------------------------------------------------------
+// Private Functions
+
+void CPhilox::generate()
+{
+    quint32 key0 = m_key[0];
+    quint32 key1 = m_key[1];
+    quint32 x0 = m_counter[0];
+    quint32 x1 = m_counter[1];
+    quint32 x2 = m_counter[2];
+    quint32 x3 = m_counter[3];
+
+    for(qint32 round = 0; round < ROUNDS; ++round) {
+        quint64 product0 = static_cast<quint64>(MULTIPLIER0) * x0;
+        quint64 product1 = static_cast<quint64>(MULTIPLIER1) * x2;
+        x0 = static_cast<quint32>(product1 >> 32) ^ x1 ^ key0;
+        x1 = static_cast<quint32>(product1);
+        x2 = static_cast<quint32>(product0 >> 32) ^ x3 ^ key1;
+        x3 = static_cast<quint32>(product0);
+        key0 += WEYL0;
+        key1 += WEYL1;
+    }
+
+    m_output[0] = x0;
+    m_output[1] = x1;
+    m_output[2] = x2;
+    m_output[3] = x3;
+}
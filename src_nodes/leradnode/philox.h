@@ -0,0 +1,55 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <QtGlobal>
+
+
+// Philox4x32-10 counter based random numbers (Salmon et al., "Parallel
+// ... Random Numbers: As Easy as 1, 2, 3"). A number depends only on the
+// ... seed, the stream, the substream and its position, so every substream
+// ... can be drawn from any thread and gives the same numbers.
+class CPhilox
+{
+  private:
+    quint32 m_key[2];
+    // Position in the substream, substream and stream.
+    quint32 m_counter[4];
+    quint32 m_output[4];
+    // The next unused number in 'm_output'.
+    qint32 m_next;
+
+  public:
+    explicit CPhilox(quint64 seed, quint32 stream, quint32 substream = 0);
+    // Get the next 32 bit random number.
+    inline quint32 next();
+    // Get a random number in [0, bound).
+    inline quint32 bounded(quint32 bound);
+
+  private:
+    // Encrypt the counter with the key into 'm_output'.
+    void generate();
+};
+
+
+// Inline functions
+
+quint32 CPhilox::next()
+{
+    if(m_next == 4) {
+        generate();
+        if(++m_counter[0] == 0) {
+            ++m_counter[1];
+        }
+        m_next = 0;
+    }
+
+    return m_output[m_next++];
+}
+
+quint32 CPhilox::bounded(quint32 bound)
+{
+    // Scale with a multiplication instead of a modulo.
+    return (static_cast<quint64>(next()) * bound) >> 32;
+}
+
+#endif // PHILOX_H
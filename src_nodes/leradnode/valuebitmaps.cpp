@@ -0,0 +1,88 @@
+#include "valuebitmaps.h"
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CValueBitmaps::CValueBitmaps(qint32 attribute_count)
+    : m_attribute_count(attribute_count)
+    , m_slots(attribute_count)
+    , m_slot_count(0)
+    , m_first(0)
+    , m_tuple_count(0)
+    , m_word_count(0)
+    , m_bitmaps()
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+qint32 CValueBitmaps::slot(qint32 attribute, Nominal value)
+{
+    QHash<Nominal, qint32> &values = m_slots[attribute];
+    auto it = values.constFind(value);
+    if(it != values.constEnd()) {
+        return it.value();
+    }
+
+    values.insert(value, m_slot_count);
+    return m_slot_count++;
+}
+
+void CValueBitmaps::build(const Nominal *dataset, qint32 first, qint32 count)
+{
+    m_first = first;
+    m_tuple_count = count;
+    m_word_count = (count + 63) / 64;
+    m_bitmaps.fill(0, m_slot_count * m_word_count);
+
+    // Only look at the attributes with indexed values.
+    QVector<qint32> attributes;
+    for(qint32 i = 0; i < m_attribute_count; ++i) {
+        if(!m_slots.at(i).isEmpty()) {
+            attributes.append(i);
+        }
+    }
+
+    quint64 *bitmaps = m_bitmaps.data();
+    const Nominal *tuple = dataset + static_cast<qint64>(first) * m_attribute_count;
+    for(qint32 i = 0; i < count; ++i, tuple += m_attribute_count) {
+        for(qint32 attribute : attributes) {
+            const QHash<Nominal, qint32> &values = m_slots.at(attribute);
+            auto it = values.constFind(tuple[attribute]);
+            if(it != values.constEnd()) {
+                bitmaps[it.value() * m_word_count + (i >> 6)] |=
+                        Q_UINT64_C(1) << (i & 63);
+            }
+        }
+    }
+}
+
+void CValueBitmaps::match(const QVector<qint32> &value_slots,
+                          quint64 *match) const
+{
+    if(value_slots.isEmpty()) {
+        for(qint32 i = 0; i < m_word_count; ++i) {
+            match[i] = ~Q_UINT64_C(0);
+        }
+        if(m_tuple_count % 64 != 0) {
+            match[m_word_count - 1] = (Q_UINT64_C(1) << (m_tuple_count % 64)) - 1;
+        }
+        return;
+    }
+
+    const quint64 *bitmap = m_bitmaps.constData() +
+            value_slots.at(0) * m_word_count;
+    for(qint32 i = 0; i < m_word_count; ++i) {
+        match[i] = bitmap[i];
+    }
+    for(qint32 j = 1; j < value_slots.size(); ++j) {
+        bitmap = m_bitmaps.constData() + value_slots.at(j) * m_word_count;
+        for(qint32 i = 0; i < m_word_count; ++i) {
+            match[i] &= bitmap[i];
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef VALUEBITMAPS_H
+#define VALUEBITMAPS_H
+
+#include "rulesetdata/ruletypes.h"
+#include <QtGlobal>
+#include <QVector>
+#include <QHash>
+
+
+// Bitmaps of the tuples of a block of a dataset that hold some attribute
+// ... values. Only the values given a slot are indexed, so that attributes
+// ... with many distinct values do not need a bitmap for each one. The
+// ... dataset is a row-major matrix with a column per attribute.
+class CValueBitmaps
+{
+  private:
+    qint32 m_attribute_count;
+    // The slot of every indexed value of every attribute.
+    QVector<QHash<Nominal, qint32>> m_slots;
+    qint32 m_slot_count;
+    // The tuples in the bitmaps.
+    qint32 m_first;
+    qint32 m_tuple_count;
+    qint32 m_word_count;
+    // A bitmap of 'm_word_count' words for each slot.
+    QVector<quint64> m_bitmaps;
+
+  public:
+    explicit CValueBitmaps(qint32 attribute_count);
+    // Get the slot of 'value' of 'attribute', adding one if needed. Slots
+    // ... must be added before building the bitmaps.
+    qint32 slot(qint32 attribute, Nominal value);
+    // Build the bitmaps of the 'count' tuples of 'dataset' from 'first'.
+    void build(const Nominal *dataset, qint32 first, qint32 count);
+    // Set in 'match' ('wordCount()' words) the tuples that hold the values
+    // ... of all the 'value_slots'. Without slots all the tuples match.
+    void match(const QVector<qint32> &value_slots, quint64 *match) const;
+    qint32 first() const { return m_first; }
+    qint32 tupleCount() const { return m_tuple_count; }
+    qint32 wordCount() const { return m_word_count; }
+};
+
+#endif // VALUEBITMAPS_H
@@ -2,10 +2,90 @@
 #include "data/datafactory.h"
 #include "data/messagedata.h"
 #include "rulesetdata/ruletypes.h"
+#include "rulesetdata/uniquetuples.h"
 #include <QDebug>
 #include <QList>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QTextStream>
+#include <QThread>
+#include <QtConcurrent>
 #include <cmath>
 
+namespace {
+    // Tuples are evaluated in parallel in blocks of this size.
+    const qint32 BLOCK_SIZE = 4096;
+
+    // The rules that fire for the distinct tuples in [first, last).
+    struct SFirings {
+        qint32 first;
+        qint32 last;
+        // The rules of tuple 'first + i' are in [offsets[i], offsets[i + 1]).
+        QVector<qint32> offsets;
+        QVector<qint32> rules;
+    };
+
+    // The rules that fire for the tuples of a block.
+    struct SBlock {
+        qint32 first;
+        qint32 last;
+        // The positions in 'rules' of the rules that fire for tuple
+        // ... 'first + i' are in [offsets[i], offsets[i + 1]) of
+        // ... 'event_positions'.
+        QVector<qint32> offsets;
+        QVector<qint32> event_positions;
+        // Every rule that fires in the block, the time of its last anomaly
+        // ... in the block and the time of its last anomaly before it.
+        QVector<qint32> rules;
+        QVector<qint32> last_times;
+        QVector<qint32> times;
+        QList<QList<QVariant>> anomalies;
+    };
+
+    // Split [0, count) in ranges of BLOCK_SIZE.
+    QVector<QPair<qint32, qint32>> blockRanges(qint32 count)
+    {
+        QVector<QPair<qint32, qint32>> ranges;
+        for(qint32 i = 0; i < count; i += BLOCK_SIZE) {
+            ranges.append(qMakePair(i, qMin(i + BLOCK_SIZE, count)));
+        }
+        return ranges;
+    }
+
+    // Turn the sum of the scores of the rules that fire for a tuple into
+    // ... its anomaly score. If the tuple is an anomaly, append the score,
+    // ... the most anomalous rule and its share of the score to 'extras'.
+    bool anomalyExtras(double score, double highest_score,
+                       qint32 i_highest_rule, QList<QVariant> &extras)
+    {
+        const double LOG10 = std::log(10);
+
+        double pct = 0.0;
+        if(score > 0.0) {
+            pct = 100 * highest_score / score;
+            score = log(score) / LOG10 - 4.5;
+        }
+        if(score <= 0.0) {
+            return false;
+        }
+
+        QString score_string;
+        QTextStream score_stream(&score_string);
+        score_stream << int(score) << ".";
+        score_stream.setFieldWidth(6);
+        score_stream.setFieldAlignment(QTextStream::AlignRight);
+        score_stream.setPadChar('0');
+        score_stream << int(score * 1000000) - int(score) * 1000000;
+        score_stream.flush();
+        extras.append(score_string);
+        extras.append(i_highest_rule);
+        extras.append(pct);
+
+        return true;
+    }
+}
+
 
 //------------------------------------------------------------------------------
 // Constructor and Destructor
@@ -30,6 +110,9 @@ void CRuleEvalNode::configure(CNodeConfig &config)
 
     // Add parameters
     //config.addFilename("file", "Input File", "File to be read from disk.");
+    config.addBool("parallel", "Parallel Evaluation", "Evaluate blocks of "
+                   "tuples in parallel. The scores are the same as when "
+                   "evaluating the tuples one by one.", true);
 
     // Add the gates.
     config.addInput("in-table", "table");
@@ -104,11 +187,34 @@ void CRuleEvalNode::evaluate()
         return;
     }
 
-    const double LOG10 = std::log(10);
+    // Only the rules that constrain the values of a tuple are evaluated,
+    // ... using the flattened rules.
+    m_ruleset_data->compile();
 
-    // Build the dataset to evaluate using the norminals of the ruleset.
-    QList<QList<Nominal>> dataset;
-    Antecedent tuple;
+    if(getConfig().getParameter("parallel")->value.toBool()) {
+        evaluateParallel();
+    }
+    else {
+        evaluateSequential();
+    }
+
+    commit("out", m_anomalies_data);
+}
+
+
+//------------------------------------------------------------------------------
+// Private Functions
+
+void CRuleEvalNode::evaluateSequential()
+{
+    const CCompiledRules &compiled = m_ruleset_data->compiled();
+    QVector<qint32> candidates;
+    qint32 attribute_count = m_table_data->headerSize();
+
+    // The tuple to evaluate using the norminals of the ruleset, padded to
+    // ... the width of the flattened rules.
+    QVector<Nominal> tuple(compiled.width(), 0);
+    Nominal *tuple_data = tuple.data();
 
     // Set the current time of evaluation to match the number of tuples
     // ... that have already been analysed previously.
@@ -119,13 +225,10 @@ void CRuleEvalNode::evaluate()
         const QList<QVariant> &row = m_table_data->getRow(i);
 
         // Iterate each attribute of the row to build tuples.
-        tuple.clear();
-        tuple.reserve(m_table_data->headerSize());
-        for(qint32 j = 0; j < m_table_data->headerSize(); ++j) {
+        for(qint32 j = 0; j < attribute_count; ++j) {
             // Convert attribute to nominal.
             QString attr = row[j].toString();
-            qint32 n = m_ruleset_data->string2nominal(attr);
-            tuple.append(n);
+            tuple_data[j] = m_ruleset_data->string2nominal(attr);
         }
 
         // Evaluate the Tuple.
@@ -135,15 +238,12 @@ void CRuleEvalNode::evaluate()
         ++now; // One more time step into the analysis.
 
         QList<CRule> &rules = m_ruleset_data->getRules();
-        QList<CRule>::iterator it = rules.begin();
-        qint32 j = 0;
-        while(it != rules.end()) {
-            CRule &rule= *it;
+        m_ruleset_data->candidateRules(tuple_data, candidates);
+        for(qint32 j : candidates) {
             double rule_score = 0;
-            if(rule.matchAntecedents(tuple) &&
-               !rule.matchConsequent(tuple) &&
-               rule.consequent.valuesCount() > 0) {
+            if(compiled.fires(j, tuple_data)) {
                 // Rule matches but the consecuent does not. Anomaly ensues.
+                CRule &rule = rules[j];
                 rule_score = double(now - rule.consequent.t) *
                              rule.consequent.n / rule.consequent.valuesCount();
                 if(rule_score > highest_score) {
@@ -153,34 +253,189 @@ void CRuleEvalNode::evaluate()
                 score += rule_score;
                 rule.consequent.t = now;
             }
-            ++it;
-            ++j;
         }
 
         // Do something if there is an anomlay.
-        double pct = 0.0;
-        if(score > 0.0) {
-            pct = 100 * highest_score / score;
-            score = log(score) / LOG10 - 4.5;
-        }
-        if(score > 0.0) {
+        QList<QVariant> extras;
+        if(anomalyExtras(score, highest_score, i_highest_rule, extras)) {
             QList<QVariant> &row = m_anomalies_data->newRow();
-            for(qint32 nominal : tuple) {
-                row.append(m_ruleset_data->nominal2string(nominal));
+            for(qint32 j = 0; j < attribute_count; ++j) {
+                row.append(m_ruleset_data->nominal2string(tuple_data[j]));
             }
-            // Append extras.
-            QString score_string;
-            QTextStream score_stream(&score_string);
-            score_stream << int(score) << ".";
-            score_stream.setFieldWidth(6);
-            score_stream.setFieldAlignment(QTextStream::AlignRight);
-            score_stream.setPadChar('0');
-            score_stream << int(score * 1000000) - int(score) * 1000000;
-            row.append(score_string);
-            row.append(i_highest_rule);
-            row.append(pct);
+            row.append(extras);
         }
     }
+}
 
-    commit("out", m_anomalies_data);
+void CRuleEvalNode::evaluateParallel()
+{
+    const CCompiledRules &compiled = m_ruleset_data->compiled();
+    const QList<CRule> &rules = m_ruleset_data->getRules();
+    const CRulesetData &ruleset = *m_ruleset_data;
+    const CTableData &table = *m_table_data;
+    qint32 attribute_count = table.headerSize();
+    qint32 rows = table.rowCount();
+    // The time of the tuple before the first one.
+    qint32 now = ruleset.tuplesCount();
+
+    // The time of the last anomaly of every rule, carried from batch to
+    // ... batch.
+    QVector<qint32> times(rules.size());
+    for(qint32 i = 0; i < rules.size(); ++i) {
+        times[i] = rules.at(i).consequent.t;
+    }
+
+    // Encode the tuples with the nominals of the ruleset, padded to the
+    // ... width of the flattened rules. Strings the ruleset has never seen
+    // ... match no rule value.
+    qint32 width = compiled.width();
+    QVector<Nominal> dataset(rows * width, 0);
+    Nominal *dataset_data = dataset.data();
+    QVector<QPair<qint32, qint32>> ranges = blockRanges(rows);
+    QtConcurrent::blockingMap(ranges, [&] (const QPair<qint32, qint32> &range) {
+        for(qint32 i = range.first; i < range.second; ++i) {
+            const QList<QVariant> &row = table.getRow(i);
+            Nominal *tuple_data = dataset_data + i * width;
+            for(qint32 j = 0; j < attribute_count; ++j) {
+                tuple_data[j] = ruleset.findNominal(row[j].toString());
+            }
+        }
+    });
+
+    // Which rules fire does not depend on the times of their last
+    // ... anomalies, so it is found once for every distinct tuple.
+    CUniqueTuples unique;
+    unique.build(dataset.constData(), rows, width);
+    dataset.clear();
+    QVector<SFirings> firings;
+    for(const QPair<qint32, qint32> &range : blockRanges(unique.size())) {
+        SFirings range_firings;
+        range_firings.first = range.first;
+        range_firings.last = range.second;
+        firings.append(range_firings);
+    }
+    QtConcurrent::blockingMap(firings, [&] (SFirings &range_firings) {
+        QVector<qint32> candidates;
+        range_firings.offsets.append(0);
+        for(qint32 u = range_firings.first; u < range_firings.last; ++u) {
+            const Nominal *tuple_data = unique.tuples() + u * width;
+            ruleset.candidateRules(tuple_data, candidates);
+            for(qint32 rule : candidates) {
+                if(compiled.fires(rule, tuple_data)) {
+                    range_firings.rules.append(rule);
+                }
+            }
+            range_firings.offsets.append(range_firings.rules.size());
+        }
+    });
+
+    // The rules that fire for distinct tuple 'u' are in [fire_offsets[u],
+    // ... fire_offsets[u + 1]) of 'fire_rules'.
+    QVector<qint32> fire_offsets;
+    QVector<qint32> fire_rules;
+    fire_offsets.append(0);
+    for(const SFirings &range_firings : firings) {
+        for(qint32 k = 1; k < range_firings.offsets.size(); ++k) {
+            fire_offsets.append(fire_rules.size() + range_firings.offsets.at(k));
+        }
+        fire_rules += range_firings.rules;
+    }
+    firings.clear();
+
+    const qint32 batch_size = BLOCK_SIZE * QThread::idealThreadCount() * 4;
+    setProgress(0);
+    for(qint32 batch = 0; batch < rows; batch += batch_size) {
+        qint32 batch_end = qMin(batch + batch_size, rows);
+        QVector<SBlock> blocks;
+        for(qint32 i = batch; i < batch_end; i += BLOCK_SIZE) {
+            SBlock block;
+            block.first = i;
+            block.last = qMin(i + BLOCK_SIZE, batch_end);
+            blocks.append(block);
+        }
+
+        // Collect the rules that fire for every tuple of the blocks and the
+        // ... time of their last anomaly in each block.
+        QtConcurrent::blockingMap(blocks, [&] (SBlock &block) {
+            QHash<qint32, qint32> positions;
+
+            block.offsets.append(0);
+            for(qint32 i = block.first; i < block.last; ++i) {
+                qint32 u = unique.index(i);
+                qint32 last = fire_offsets.at(u + 1);
+                for(qint32 e = fire_offsets.at(u); e < last; ++e) {
+                    qint32 rule = fire_rules.at(e);
+                    auto it = positions.constFind(rule);
+                    if(it == positions.constEnd()) {
+                        it = positions.insert(rule, block.rules.size());
+                        block.rules.append(rule);
+                        block.last_times.append(0);
+                    }
+                    block.event_positions.append(it.value());
+                    block.last_times[it.value()] = now + i + 1;
+                }
+                block.offsets.append(block.event_positions.size());
+            }
+        });
+
+        // Pass the time of the last anomaly of every rule from block to
+        // ... block, like a prefix scan.
+        for(SBlock &block : blocks) {
+            block.times.resize(block.rules.size());
+            for(qint32 k = 0; k < block.rules.size(); ++k) {
+                qint32 rule = block.rules.at(k);
+                block.times[k] = times.at(rule);
+                times[rule] = block.last_times.at(k);
+            }
+        }
+
+        // Score the tuples of every block with the rules in the same order
+        // ... as the sequential evaluation.
+        QtConcurrent::blockingMap(blocks, [&] (SBlock &block) {
+            for(qint32 i = block.first; i < block.last; ++i) {
+                double score = 0.0;
+                double highest_score = 0.0;
+                qint32 i_highest_rule = 0;
+                qint32 tuple_now = now + i + 1;
+
+                qint32 last = block.offsets.at(i - block.first + 1);
+                for(qint32 e = block.offsets.at(i - block.first); e < last; ++e) {
+                    qint32 position = block.event_positions.at(e);
+                    qint32 j = block.rules.at(position);
+                    qint32 &t = block.times[position];
+                    const CRule &rule = rules.at(j);
+                    double rule_score = double(tuple_now - t) *
+                            rule.consequent.n / rule.consequent.valuesCount();
+                    if(rule_score > highest_score) {
+                        highest_score = rule_score;
+                        i_highest_rule = j;
+                    }
+                    score += rule_score;
+                    t = tuple_now;
+                }
+
+                QList<QVariant> extras;
+                if(anomalyExtras(score, highest_score, i_highest_rule, extras)) {
+                    const QList<QVariant> &row = table.getRow(i);
+                    QList<QVariant> anomaly;
+                    for(qint32 j = 0; j < attribute_count; ++j) {
+                        anomaly.append(row[j].toString());
+                    }
+                    anomaly.append(extras);
+                    block.anomalies.append(anomaly);
+                }
+            }
+        });
+
+        for(const SBlock &block : blocks) {
+            m_anomalies_data->appendRows(block.anomalies);
+        }
+        setProgress(static_cast<qint64>(batch_end) * 100 / rows);
+    }
+
+    // Leave the rules as the sequential evaluation does.
+    QList<CRule> &modifiable_rules = m_ruleset_data->getRules();
+    for(qint32 i = 0; i < modifiable_rules.size(); ++i) {
+        modifiable_rules[i].consequent.t = times.at(i);
+    }
 }
@@ -35,6 +35,14 @@ class CRuleEvalNode: public CNode
     virtual bool data(QString gate_name, const CConstDataPointer &data);
     // Do the evaluation of the Ruleset on the Table.
     void evaluate();
+
+  private:
+    // Score the tuples one after the other.
+    void evaluateSequential();
+    // Find the rules that fire for every distinct tuple in parallel, pass
+    // ... the time of the last anomaly of every rule from block to block and
+    // ... score the blocks in parallel.
+    void evaluateParallel();
 };
 
 #endif // RULEEVALNODE_H
@@ -1,4 +1,5 @@
 QT += core
+QT += concurrent
 QT -= gui
 
 TARGET = ruleevalnode
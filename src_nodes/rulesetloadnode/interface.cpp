@@ -0,0 +1,15 @@
+#include "interface.h"
+#include "rulesetloadnode.h"
+
+extern "C"
+{
+    void configure(CNodeConfig &config)
+    {
+        CRulesetLoadNode::configure(config);
+    }
+
+    CNode *maker(const CNodeConfig &config)
+    {
+        return new CRulesetLoadNode(config);
+    }
+}
@@ -0,0 +1,86 @@
+#include "rulesetloadnode.h"
+#include "data/datafactory.h"
+#include "data/messagedata.h"
+#include "rulesetdata/rulesetdata.h"
+#include "rulesetdata/rulesetfile.h"
+#include <QDebug>
+#include <QFile>
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CRulesetLoadNode::CRulesetLoadNode(const CNodeConfig &config, QObject *parent/* = 0*/)
+    : CNode(config, parent)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+void CRulesetLoadNode::configure(CNodeConfig &config)
+{
+    config.setDescription("Read a ruleset saved by the LERAD node, so that "
+                          "it can be evaluated without training again.");
+
+    // Add parameters
+    config.addFilename("input_file", "Input File",
+                       "Path of the binary ruleset file to read.");
+    config.setCategory("Input");
+    // Add inputs and outputs
+    config.addOutput("out", "ruleset");
+}
+
+
+//------------------------------------------------------------------------------
+// Protected Functions
+
+bool CRulesetLoadNode::start()
+{
+    QVariant filename = getConfig().getParameter("input_file")->value;
+
+    // Check if the user supplied file exists before we start processing.
+    QFile file(filename.toString());
+    if(!file.exists()) {
+        QString error = "File " + filename.toString() + " does not exist.";
+        logError(error);
+        return false;
+    }
+
+    return true;
+}
+
+bool CRulesetLoadNode::data(QString gate_name, const CConstDataPointer &data)
+{
+    // No input gates.
+    Q_UNUSED(gate_name);
+
+    if(data->getType() == "message") {
+        auto pmsg = data.staticCast<const CMessageData>();
+        QString msg = pmsg->getMessage();
+        if(msg == "start") {
+            // Create the ruleset and read the file into it.
+            QSharedPointer<CRulesetData> ruleset =
+                    QSharedPointer<CRulesetData>(
+                        static_cast<CRulesetData *>(createData("ruleset")));
+            QString filename = getConfig().getParameter("input_file")->value.toString();
+            QString error;
+
+            if(ruleset.isNull()) {
+                commitError("out", "Could not create the ruleset.");
+            }
+            else if(!CRulesetFile::load(filename, *ruleset, error)) {
+                commitError("out", error);
+            }
+            else {
+                logInfo(QString("Read %1 rules.").arg(ruleset->size()));
+                commit("out", ruleset);
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,15 @@
+#include "interface.h"
+#include "rulesetmergenode.h"
+
+extern "C"
+{
+    void configure(CNodeConfig &config)
+    {
+        CRulesetMergeNode::configure(config);
+    }
+
+    CNode *maker(const CNodeConfig &config)
+    {
+        return new CRulesetMergeNode(config);
+    }
+}
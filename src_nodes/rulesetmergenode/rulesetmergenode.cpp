@@ -0,0 +1,101 @@
+#include "rulesetmergenode.h"
+#include "data/datafactory.h"
+#include <QDebug>
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CRulesetMergeNode::CRulesetMergeNode(const CNodeConfig &config, QObject *parent/* = 0*/)
+    : CNode(config, parent)
+    , m_received(0)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+void CRulesetMergeNode::configure(CNodeConfig &config)
+{
+    config.setDescription("Merge the rulesets that LERAD trained on "
+                          "partitions of a dataset. The rulesets are merged "
+                          "in the order they arrive, which should be the "
+                          "order of their partitions. The support of a rule "
+                          "is approximated by the sum of its support in "
+                          "every partition, so no rule is validated on the "
+                          "whole dataset. Use the partitions parameter of "
+                          "LERAD to get the exact support.");
+    config.setCategory("Algorithm");
+
+    // Add parameters
+    config.addBool("prune_rules", "Prune the Rules", "Remove the duplicated "
+                   "rules and the rules that only fire when a more general "
+                   "rule with the same or better n/r fires.", false);
+    config.addUInt("max_rules", "Maximum Rules", "Keep at most this many "
+                   "rules with the best n/r when pruning (0 keeps them all).",
+                   0);
+
+    // Add inputs and outputs
+    config.addInput("in", "ruleset");
+    config.addOutput("out", "ruleset");
+}
+
+
+//------------------------------------------------------------------------------
+// Protected Functions
+
+bool CRulesetMergeNode::start()
+{
+    m_ruleset = QSharedPointer<CRulesetData>(
+        static_cast<CRulesetData *>(createData("ruleset")));
+    m_received = 0;
+
+    if(!m_ruleset.isNull()) {
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+bool CRulesetMergeNode::data(QString gate_name, const CConstDataPointer &data)
+{
+    Q_UNUSED(gate_name);
+
+    if(data->getType() == "ruleset") {
+        auto ruleset = data.staticCast<const CRulesetData>();
+        if(!m_ruleset->merge(*ruleset)) {
+            // Skip the ruleset, the others are still merged.
+            commitError("out", "Cannot merge rulesets with a different "
+                        "number of attributes.");
+        }
+
+        // Forward the ruleset once every connected node sent its own, even
+        // ... if some of them could not be merged.
+        ++m_received;
+        if(m_received >= inputLinkCount("in")) {
+            logInfo(QString("Merged %1 rulesets into %2 rules.")
+                    .arg(m_received).arg(m_ruleset->size()));
+            if(getConfig().getParameter("prune_rules")->value.toBool()) {
+                qint32 max_rules =
+                        getConfig().getParameter("max_rules")->value.toInt();
+                SPruneReport report = m_ruleset->prune(max_rules);
+                logInfo(QString("Removed %1 duplicated, %2 dominated and %3 "
+                                "capped rules, %4 rules left.")
+                        .arg(report.duplicates).arg(report.dominated)
+                        .arg(report.capped).arg(m_ruleset->size()));
+            }
+            commit("out", m_ruleset);
+            // Start again with an empty ruleset.
+            m_ruleset = QSharedPointer<CRulesetData>(
+                static_cast<CRulesetData *>(createData("ruleset")));
+            m_received = 0;
+        }
+
+        return true;
+    }
+
+    return false;
+}
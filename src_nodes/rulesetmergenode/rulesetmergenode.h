@@ -0,0 +1,33 @@
+#ifndef RULESETMERGENODE_H
+#define RULESETMERGENODE_H
+
+#include "node/node.h"
+#include "node/nodeconfig.h"
+#include "rulesetdata/rulesetdata.h"
+#include <QObject>
+#include <QString>
+
+class CRulesetMergeNode: public CNode
+{
+  Q_OBJECT
+
+  private:
+    // The rulesets received so far merged into one.
+    QSharedPointer<CRulesetData> m_ruleset;
+    // Number of rulesets received.
+    qint32 m_received;
+
+  public:
+    // Constructor
+    explicit CRulesetMergeNode(const CNodeConfig &config, QObject *parent = 0);
+    // Set the configuration template for this Node.
+    static void configure(CNodeConfig &config);
+
+  protected:
+    // Function called when the simulation is started.
+    virtual bool start();
+    // Receive data sent by other nodes connected to this node.
+    virtual bool data(QString gate_name, const CConstDataPointer &data);
+};
+
+#endif // RULESETMERGENODE_H
@@ -6,6 +6,10 @@ SUBDIRS += \
             tcpstreamextractornode \
             tcpstreamfeaturesnode \
             tablefiledumpnode \
+            tablesortnode \
+            tableloadnode \
+            rulesetloadnode \
+            rulesetmergenode \
             leradnode \
             ruleevalnode \
             pythonnode \
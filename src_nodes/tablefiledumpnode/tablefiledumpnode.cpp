@@ -1,6 +1,7 @@
 #include "tablefiledumpnode.h"
 #include "data/datafactory.h"
 #include "data/messagedata.h"
+#include "tabledata/tablefile.h"
 #include <QDebug>
 #include <QFile>
 #include <QTextStream>
@@ -34,6 +35,11 @@ void CTableFileDumpNode::configure(CNodeConfig &config)
     config.addBool("csv", "Table data in CSM format",
                    "Write the table data with the CSV file format.",
                    false);
+    config.addBool("binary", "Binary Table File",
+                   "Write the table in the binary format read by the tableload "
+                   "node. The append and CSV options are ignored.", false);
+    config.addBool("compress", "Compress Binary File",
+                   "Compress the pages of the binary table file.", true);
     // Add the gates.
     config.addInput("in", "table");
 }
@@ -60,10 +66,22 @@ bool CTableFileDumpNode::data(QString gate_name, const CConstDataPointer &data)
     QString filename = getConfig().getParameter("output_filename")->value.toString();
     bool append = getConfig().getParameter("append")->value.toBool();
     bool csv = getConfig().getParameter("csv")->value.toBool();
+    bool binary = getConfig().getParameter("binary")->value.toBool();
+    bool compress = getConfig().getParameter("compress")->value.toBool();
 
     // The data we have received interpreted as a table.
     auto table = data.staticCast<const CTableData>();
 
+    if(binary) {
+        if(CTableFile::save(*table, filename, compress)) {
+            LOG_INFO(QString("Wrote %1").arg(filename));
+        }
+        else {
+            LOG_WARNING("Could NOT write " + filename);
+        }
+        return true;
+    }
+
     // Print the table data into the user-supplied filename.
     if(printTable(table, filename, append, csv)) {
         LOG_INFO(QString("Wrote %1").arg(filename));
@@ -122,7 +140,8 @@ bool CTableFileDumpNode::printTable(QSharedPointer<const CTableData> &table,
         const QList<QVariant> &row = table->getRow(i);
         col_count = row.size();
         for(qint32 j = 0; j < col_count; ++j) {
-            out << row.at(j).toString();
+            // Typed columns (e.g., addresses) are formatted here.
+            out << table->formatValue(j, row.at(j));
             if(j != col_count - 1) {
                 if(!csv) {
                     out << '\t';
@@ -0,0 +1,15 @@
+#include "interface.h"
+#include "tableloadnode.h"
+
+extern "C"
+{
+    void configure(CNodeConfig &config)
+    {
+        CTableLoadNode::configure(config);
+    }
+
+    CNode *maker(const CNodeConfig &config)
+    {
+        return new CTableLoadNode(config);
+    }
+}
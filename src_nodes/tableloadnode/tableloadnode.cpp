@@ -0,0 +1,86 @@
+#include "tableloadnode.h"
+#include "data/datafactory.h"
+#include "data/messagedata.h"
+#include "tabledata/tabledata.h"
+#include "tabledata/tablefile.h"
+#include <QDebug>
+#include <QFile>
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CTableLoadNode::CTableLoadNode(const CNodeConfig &config, QObject *parent/* = 0*/)
+    : CNode(config, parent)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+void CTableLoadNode::configure(CNodeConfig &config)
+{
+    config.setDescription("Read a table written by the tablefiledump node in "
+                          "the binary format.");
+
+    // Add parameters
+    config.addFilename("input_file", "Input File",
+                       "Path of the binary table file to read.");
+    config.setCategory("Input");
+    // Add inputs and outputs
+    config.addOutput("out", "table");
+}
+
+
+//------------------------------------------------------------------------------
+// Protected Functions
+
+bool CTableLoadNode::start()
+{
+    QVariant filename = getConfig().getParameter("input_file")->value;
+
+    // Check if the user supplied file exists before we start processing.
+    QFile file(filename.toString());
+    if(!file.exists()) {
+        QString error = "File " + filename.toString() + " does not exist.";
+        logError(error);
+        return false;
+    }
+
+    return true;
+}
+
+bool CTableLoadNode::data(QString gate_name, const CConstDataPointer &data)
+{
+    // No input gates.
+    Q_UNUSED(gate_name);
+
+    if(data->getType() == "message") {
+        auto pmsg = data.staticCast<const CMessageData>();
+        QString msg = pmsg->getMessage();
+        if(msg == "start") {
+            // Create the table and read the file into it.
+            QSharedPointer<CTableData> table =
+                    QSharedPointer<CTableData>(
+                        static_cast<CTableData *>(createData("table")));
+            QString filename = getConfig().getParameter("input_file")->value.toString();
+            QString error;
+
+            if(table.isNull()) {
+                commitError("out", "Could not create the table.");
+            }
+            else if(!CTableFile::load(filename, *table, error)) {
+                commitError("out", error);
+            }
+            else {
+                logInfo(QString("Read %1 rows.").arg(table->rowCount()));
+                commit("out", table);
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
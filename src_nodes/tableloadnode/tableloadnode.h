@@ -0,0 +1,27 @@
+#ifndef TABLELOADNODE_H
+#define TABLELOADNODE_H
+
+#include "node/node.h"
+#include "node/nodeconfig.h"
+#include <QObject>
+#include <QString>
+
+class CTableLoadNode: public CNode
+{
+  Q_OBJECT
+
+  public:
+    // Constructor
+    explicit CTableLoadNode(const CNodeConfig &config, QObject *parent = 0);
+    // Set the configuration template for this Node.
+    static void configure(CNodeConfig &config);
+
+  protected:
+    // Function called when the simulation is started.
+    // ... Check the file set in the parameters.
+    virtual bool start();
+    // Receive data sent by other nodes connected to this node.
+    virtual bool data(QString gate_name, const CConstDataPointer &data);
+};
+
+#endif // TABLELOADNODE_H
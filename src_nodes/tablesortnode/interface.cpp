@@ -0,0 +1,16 @@
+#include "interface.h"
+#include "tablesortnode.h"
+
+extern "C"
+{
+void configure(CNodeConfig &config)
+{
+    CTableSortNode::configure(config);
+}
+
+CNode *maker(const CNodeConfig &config)
+{
+    return new CTableSortNode(config);
+}
+}
+
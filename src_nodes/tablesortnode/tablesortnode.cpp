@@ -0,0 +1,413 @@
+#include "tablesortnode.h"
+#include "data/datafactory.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QVector>
+#include <queue>
+#include <vector>
+
+namespace {
+    // Tags of the values stored in the runs.
+    enum ECell {invalid_cell = 0, bool_cell, int_cell, uint_cell, longlong_cell,
+                ulonglong_cell, double_cell, string_cell, variant_cell = 0xff};
+}
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CTableSortNode::CTableSortNode(const CNodeConfig &config, QObject *parent/* = 0*/)
+    : CNode(config, parent)
+    , m_run_rows(1)
+    , m_chunk_rows(0)
+    , m_tables(0)
+    , m_rows(0)
+    , m_chunks(0)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+void CTableSortNode::configure(CNodeConfig &config)
+{
+    config.setDescription("Sort tables that may not fit in memory. Sorted runs of "
+                          "rows are written to disk and merged once all the "
+                          "input tables have arrived.");
+
+    //Set the category
+    config.setCategory("Processing");
+
+    // Add parameters
+    config.addString("keys", "Sort Keys",
+                     "Columns to sort by, separated by commas. Each column is a "
+                     "header name or index, optionally followed by \"asc\" or "
+                     "\"desc\" (e.g., \"Timestamp, DUR desc\").", "0");
+    config.addUInt("run_rows", "Rows in Memory",
+                   "The number of rows sorted in memory before they are written "
+                   "to disk as a sorted run.", 1000000);
+    config.addUInt("chunk_rows", "Rows per Output Table",
+                   "Send the sorted rows in tables of this many rows (0 sends a "
+                   "single table). Nodes that expect a table per link need 0.",
+                   0);
+    config.addString("temp_dir", "Temporary Directory",
+                     "Where the sorted runs are written (empty uses the "
+                     "system temporary directory).", "");
+
+    // Add the gates.
+    config.addInput("in", "table");
+    config.addOutput("out", "table");
+}
+
+
+//------------------------------------------------------------------------------
+// Protected Functions
+
+bool CTableSortNode::start()
+{
+    m_keys_spec = getConfig().getParameter("keys")->value.toString();
+    m_run_rows = qMax(getConfig().getParameter("run_rows")->value.toUInt(), 1u);
+    m_chunk_rows = getConfig().getParameter("chunk_rows")->value.toUInt();
+    m_temp_path = getConfig().getParameter("temp_dir")->value.toString();
+    if(m_temp_path.isEmpty()) {
+        m_temp_path = QDir::tempPath();
+    }
+    reset();
+
+    return true;
+}
+
+bool CTableSortNode::data(QString gate_name, const CConstDataPointer &data)
+{
+    Q_UNUSED(gate_name);
+
+    if(data->getType() != "table") {
+        // Do not process data that is not a table.
+        return false;
+    }
+
+    auto table = data.staticCast<const CTableData>();
+
+    // The first table gives the header and the columns of the keys.
+    if(m_header.isNull()) {
+        if(!table->parseSortKeys(m_keys_spec, m_keys)) {
+            commitError("out", "Invalid sort keys: " + m_keys_spec);
+            return true;
+        }
+        m_header = QSharedPointer<CTableData>(
+                    static_cast<CTableData *>(createData("table")));
+        if(m_header.isNull()) {
+            commitError("out", "Could not create the sorted table.");
+            return true;
+        }
+        for(qint32 i = 0; i < table->headerSize(); ++i) {
+            m_header->addHeader(table->header().at(i), table->headerFormat(i));
+        }
+        m_run = createTable();
+    }
+
+    // Fill the runs, writing each one to disk once it is full.
+    qint32 row_count = table->rowCount();
+    for(qint32 i = 0; i < row_count; ++i) {
+        m_run->newRow() = table->getRow(i);
+        if(m_run->rowCount() >= m_run_rows && !writeRun()) {
+            commitError("out", "Could not write a sorted run to " + m_temp_path);
+            reset();
+            return true;
+        }
+    }
+    m_rows += row_count;
+    ++m_tables;
+
+    if(m_tables < getInputCount("in")) {
+        // Wait for the rest of the tables.
+        return true;
+    }
+
+    if(m_run_files.isEmpty()) {
+        // Everything fits in memory.
+        m_run->sort(m_keys);
+        if(m_chunk_rows == 0) {
+            commit("out", m_run);
+        }
+        else {
+            for(const QList<QVariant> &row : m_run->table()) {
+                appendOutput(row);
+            }
+            flushOutput();
+        }
+    }
+    else {
+        if(m_run->rowCount() > 0 && !writeRun()) {
+            commitError("out", "Could not write a sorted run to " + m_temp_path);
+        }
+        else if(mergeRuns()) {
+            flushOutput();
+        }
+    }
+
+    reset();
+
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+// Private Functions
+
+QSharedPointer<CTableData> CTableSortNode::createTable()
+{
+    auto table = QSharedPointer<CTableData>(
+                static_cast<CTableData *>(createData("table")));
+    for(qint32 i = 0; i < m_header->headerSize(); ++i) {
+        table->addHeader(m_header->header().at(i), m_header->headerFormat(i));
+    }
+
+    return table;
+}
+
+bool CTableSortNode::writeRun()
+{
+    if(m_run_dir.isNull()) {
+        m_run_dir = QSharedPointer<QTemporaryDir>(
+                    new QTemporaryDir(QDir(m_temp_path).filePath("anise-sort-XXXXXX")));
+        if(!m_run_dir->isValid()) {
+            m_run_dir.clear();
+            return false;
+        }
+    }
+
+    QString filename = QDir(m_run_dir->path()).filePath(
+                QString("run%1").arg(m_run_files.size()));
+    QFile file(filename);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    m_run->sort(m_keys);
+    QDataStream out(&file);
+    for(const QList<QVariant> &row : m_run->table()) {
+        writeRow(out, row);
+    }
+    if(out.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    logInfo(QString("Wrote a sorted run of %1 rows.").arg(m_run->rowCount()));
+    m_run_files.append(filename);
+    m_run = createTable();
+
+    return true;
+}
+
+bool CTableSortNode::mergeRuns()
+{
+    qint32 run_count = m_run_files.size();
+    QList<QSharedPointer<QFile>> files;
+    QList<QSharedPointer<QDataStream>> streams;
+    QVector<QList<QVariant>> heads(run_count);
+
+    // Take the first row of every run.
+    for(qint32 i = 0; i < run_count; ++i) {
+        auto file = QSharedPointer<QFile>(new QFile(m_run_files.at(i)));
+        if(!file->open(QIODevice::ReadOnly)) {
+            commitError("out", "Could not read the sorted run " + m_run_files.at(i));
+            return false;
+        }
+        files.append(file);
+        streams.append(QSharedPointer<QDataStream>(new QDataStream(file.data())));
+    }
+
+    // The run with the smallest row is on top. Equal rows are taken from
+    // ... the earlier run first to keep the sort stable.
+    auto after = [&] (qint32 run1, qint32 run2)
+    {
+        if(CTableData::lessThan(heads.at(run2), heads.at(run1), m_keys)) {
+            return true;
+        }
+        if(CTableData::lessThan(heads.at(run1), heads.at(run2), m_keys)) {
+            return false;
+        }
+        return run1 > run2;
+    };
+    std::priority_queue<qint32, std::vector<qint32>, decltype(after)> queue(after);
+
+    for(qint32 i = 0; i < run_count; ++i) {
+        if(readRow(*streams.at(i), heads[i])) {
+            queue.push(i);
+        }
+    }
+
+    qint64 merged = 0;
+    while(!queue.empty()) {
+        qint32 run = queue.top();
+        queue.pop();
+        appendOutput(heads.at(run));
+        if(readRow(*streams.at(run), heads[run])) {
+            queue.push(run);
+        }
+
+        // Report progress every so often.
+        ++merged;
+        if(merged % 65536 == 0) {
+            setProgress(merged * 100 / m_rows);
+        }
+    }
+
+    if(merged != m_rows) {
+        commitError("out", "The sorted runs are incomplete.");
+        return false;
+    }
+
+    return true;
+}
+
+void CTableSortNode::appendOutput(const QList<QVariant> &row)
+{
+    if(m_output.isNull()) {
+        m_output = createTable();
+    }
+
+    m_output->newRow() = row;
+    if(m_chunk_rows > 0 && m_output->rowCount() >= m_chunk_rows) {
+        commit("out", m_output);
+        m_output.clear();
+        ++m_chunks;
+    }
+}
+
+void CTableSortNode::flushOutput()
+{
+    // Send the last rows, or an empty table if nothing was sent.
+    if(m_output.isNull() && m_chunks == 0) {
+        m_output = createTable();
+    }
+    if(!m_output.isNull()) {
+        commit("out", m_output);
+        m_output.clear();
+    }
+}
+
+void CTableSortNode::reset()
+{
+    m_keys.clear();
+    m_header.clear();
+    m_run.clear();
+    m_run_files.clear();
+    // Removes the runs from disk.
+    m_run_dir.clear();
+    m_tables = 0;
+    m_rows = 0;
+    m_output.clear();
+    m_chunks = 0;
+}
+
+void CTableSortNode::writeRow(QDataStream &out, const QList<QVariant> &row)
+{
+    out << static_cast<quint32>(row.size());
+    for(const QVariant &value : row) {
+        switch(static_cast<QMetaType::Type>(value.userType())) {
+        case QMetaType::UnknownType:
+            out << static_cast<quint8>(invalid_cell);
+            break;
+        case QMetaType::Bool:
+            out << static_cast<quint8>(bool_cell) << value.toBool();
+            break;
+        case QMetaType::Int:
+            out << static_cast<quint8>(int_cell) << value.toInt();
+            break;
+        case QMetaType::UInt:
+            out << static_cast<quint8>(uint_cell) << value.toUInt();
+            break;
+        case QMetaType::LongLong:
+            out << static_cast<quint8>(longlong_cell) << value.toLongLong();
+            break;
+        case QMetaType::ULongLong:
+            out << static_cast<quint8>(ulonglong_cell) << value.toULongLong();
+            break;
+        case QMetaType::Double:
+            out << static_cast<quint8>(double_cell) << value.toDouble();
+            break;
+        case QMetaType::QString:
+            out << static_cast<quint8>(string_cell) << value.toString();
+            break;
+        default:
+            out << static_cast<quint8>(variant_cell) << value;
+            break;
+        }
+    }
+}
+
+bool CTableSortNode::readRow(QDataStream &in, QList<QVariant> &row)
+{
+    row.clear();
+    if(in.atEnd()) {
+        return false;
+    }
+
+    quint32 size;
+    in >> size;
+    row.reserve(size);
+    for(quint32 i = 0; i < size && in.status() == QDataStream::Ok; ++i) {
+        quint8 cell;
+        in >> cell;
+        switch(cell) {
+        case invalid_cell:
+            row.append(QVariant());
+            break;
+        case bool_cell: {
+            bool value;
+            in >> value;
+            row.append(value);
+            break;
+        }
+        case int_cell: {
+            qint32 value;
+            in >> value;
+            row.append(value);
+            break;
+        }
+        case uint_cell: {
+            quint32 value;
+            in >> value;
+            row.append(value);
+            break;
+        }
+        case longlong_cell: {
+            qint64 value;
+            in >> value;
+            row.append(value);
+            break;
+        }
+        case ulonglong_cell: {
+            quint64 value;
+            in >> value;
+            row.append(value);
+            break;
+        }
+        case double_cell: {
+            double value;
+            in >> value;
+            row.append(value);
+            break;
+        }
+        case string_cell: {
+            QString value;
+            in >> value;
+            row.append(value);
+            break;
+        }
+        default: {
+            QVariant value;
+            in >> value;
+            row.append(value);
+            break;
+        }
+        }
+    }
+
+    return in.status() == QDataStream::Ok;
+}
@@ -0,0 +1,75 @@
+#ifndef TABLESORTNODE_H
+#define TABLESORTNODE_H
+
+#include "node/node.h"
+#include "node/nodeconfig.h"
+#include "tabledata/tabledata.h"
+#include <QDataStream>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QVariant>
+
+
+// Sort tables that may not fit in memory. The rows are sorted in runs of a
+// ... limited size that are written to disk and merged once all the tables
+// ... have arrived.
+class CTableSortNode: public CNode
+{
+  Q_OBJECT
+
+  private:
+    // Parameters
+    QString m_keys_spec;
+    QList<CTableData::SSortKey> m_keys;
+    qint32 m_run_rows;
+    qint32 m_chunk_rows;
+    QString m_temp_path;
+    // An empty table with the header of the received tables.
+    QSharedPointer<CTableData> m_header;
+    // The rows of the run being filled.
+    QSharedPointer<CTableData> m_run;
+    // Where the sorted runs are written and their file names.
+    QSharedPointer<QTemporaryDir> m_run_dir;
+    QStringList m_run_files;
+    // How many tables and rows have been received.
+    qint32 m_tables;
+    qint64 m_rows;
+    // The chunk being filled and the number of chunks sent.
+    QSharedPointer<CTableData> m_output;
+    qint32 m_chunks;
+
+  public:
+    // Constructor
+    explicit CTableSortNode(const CNodeConfig &config, QObject *parent = 0);
+    // Set the configuration template for this Node.
+    static void configure(CNodeConfig &config);
+
+  protected:
+    // Function called when the simulation is started.
+    virtual bool start();
+    // Receive data sent by other nodes connected to this node.
+    virtual bool data(QString gate_name, const CConstDataPointer &data);
+
+  private:
+    // A table with the header of the received tables.
+    QSharedPointer<CTableData> createTable();
+    // Sort the current run and write it to disk.
+    bool writeRun();
+    // Merge the runs written to disk and send the sorted rows.
+    bool mergeRuns();
+    // Add a row to the output, which is sent when a chunk is full.
+    void appendOutput(const QList<QVariant> &row);
+    // Send the rows left in the output.
+    void flushOutput();
+    // Forget the rows and runs of the tables received so far.
+    void reset();
+    // Read and write rows in the binary format of the runs.
+    static void writeRow(QDataStream &out, const QList<QVariant> &row);
+    static bool readRow(QDataStream &in, QList<QVariant> &row);
+};
+
+#endif // TABLESORTNODE_H
@@ -10,6 +10,8 @@
 
 CTcpDumpNode::CTcpDumpNode(const CNodeConfig &config, QObject *parent/* = 0*/)
     : CNode(config, parent)
+    , m_filter()
+    , m_output_filter()
 {
 
 }
@@ -22,6 +24,15 @@ void CTcpDumpNode::configure(CNodeConfig &config)
 {
     config.setDescription("Parse the contents received into TCP Packets.");
 
+    config.addBool("packet_index", "Use a Packet Index",
+                   "Store where each packet starts in a file next to the TCP "
+                   "dump (with the .idx extension) and reuse it in later runs.",
+                   false);
+    config.addString("filter", "Packet Filter",
+                     "Only keep the packets matching this expression, e.g., "
+                     "\"tcp and dst net 10.0.0.0/8 and dst portrange 1-1024\".",
+                     "");
+
     //Set the category
     config.setCategory("DataDump");
 
@@ -36,6 +47,14 @@ void CTcpDumpNode::configure(CNodeConfig &config)
 
 bool CTcpDumpNode::start()
 {
+    m_filter = getConfig().getParameter("filter")->value.toString();
+
+    CPacketFilter filter;
+    if(!filter.compile(m_filter)) {
+        logError("Invalid packet filter: " + filter.errorString());
+        return false;
+    }
+
     return true;
 }
 
@@ -49,11 +68,29 @@ bool CTcpDumpNode::data(QString gate_name, const CConstDataPointer &data)
         QSharedPointer<CTcpDumpData> tcpdump = QSharedPointer<CTcpDumpData>(
                     static_cast<CTcpDumpData *>(createData("tcpdump")));
 
+        QString index_file;
+        if(getConfig().getParameter("packet_index")->value.toBool() &&
+           !file->getFilename().isEmpty()) {
+            index_file = file->getFilename() + ".idx";
+        }
+
+        // Both the user filter and the one of our receivers must match.
+        QString filter = m_filter;
+        if(!m_output_filter.isEmpty()) {
+            filter = filter.isEmpty() ? m_output_filter :
+                    "(" + filter + ") and (" + m_output_filter + ")";
+        }
+        tcpdump->setFilter(filter);
+
         setProgress(0);
         tcpdump->setNodeReporter(this);
-        tcpdump->parse(file->getBytes());
+        tcpdump->parse(file->getBytes(), index_file);
         QString info = "Packets parsed: "+ QVariant(tcpdump->availablePackets()).toString();
         logInfo(info);
+        if(!filter.isEmpty()) {
+            info = "Packets filtered out: " + QVariant(tcpdump->filteredPackets()).toString();
+            logInfo(info);
+        }
         tcpdump->unsetNodeReporter();
         setProgress(100);
 
@@ -63,3 +100,14 @@ bool CTcpDumpNode::data(QString gate_name, const CConstDataPointer &data)
 
     return false;
 }
+
+bool CTcpDumpNode::acceptFilter(QString gate_name, QString filter)
+{
+    CPacketFilter packet_filter;
+    if(gate_name != "out" || !packet_filter.compile(filter)) {
+        return false;
+    }
+
+    m_output_filter = filter;
+    return true;
+}
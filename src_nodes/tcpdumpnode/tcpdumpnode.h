@@ -11,6 +11,12 @@ class CTcpDumpNode: public CNode
 {
   Q_OBJECT
 
+  private:
+    // Packet filter set by the user and the one requested by the nodes
+    // ... receiving our packets.
+    QString m_filter;
+    QString m_output_filter;
+
   public:
     // Constructor
     explicit CTcpDumpNode(const CNodeConfig &config, QObject *parent = 0);
@@ -23,6 +29,8 @@ class CTcpDumpNode: public CNode
     virtual bool start();
     // Receive data sent by other nodes connected to this node.
     virtual bool data(QString gate_name, const CConstDataPointer &data);
+    // Discard the packets not matching 'filter' while parsing.
+    virtual bool acceptFilter(QString gate_name, QString filter);
 };
 
 #endif // TCPDUMPNODE_H
@@ -4,6 +4,23 @@
 #include "data/messagedata.h"
 #include <QDebug>
 #include <QHostAddress>
+#include <QPair>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+    // The time of the first packet of a capture.
+    double startTime(const CTcpDumpData &capture)
+    {
+        if(capture.availablePackets() == 0) {
+            return 0;
+        }
+        return capture.getPacket(0)->time;
+    }
+}
 
 
 //------------------------------------------------------------------------------
@@ -12,6 +29,15 @@
 CTcpStreamExtractorNode::CTcpStreamExtractorNode(const CNodeConfig &config,
                                                  QObject *parent/* = 0*/)
     : CNode(config, parent)
+    , m_shard_streams()
+    , m_shards(1)
+    , m_incremental(false)
+    , m_capture_count(0)
+    , m_captures()
+    , m_packets(0)
+    , m_dest_filter(false)
+    , m_dest_networks()
+    , m_dest_ports()
 {
 
 }
@@ -29,6 +55,41 @@ void CTcpStreamExtractorNode::configure(CNodeConfig &config)
                    "The maximum number of bytes that will be stored for "
                    "the contents of a TCP stream.",
                    102400);
+    config.addUInt("idle_timeout", "Idle Timeout",
+                   "Close streams that have not seen a packet for this many "
+                   "seconds (0 disables the timeout).", 0);
+    config.addUInt("active_timeout", "Active Timeout",
+                   "Close streams that have been open for this many seconds "
+                   "(0 disables the timeout).", 0);
+    config.addUInt("max_open_streams", "Maximum Open Streams",
+                   "Close the least recently active streams when more streams "
+                   "than this are open (0 disables the limit). With several "
+                   "threads every thread gets an equal share of the limit.",
+                   0);
+    config.addUInt("max_open_payload", "Maximum Open Payload (MB)",
+                   "Close the least recently active streams when the open "
+                   "streams hold more payload than this (0 disables the limit). "
+                   "With several threads every thread gets an equal share of "
+                   "the limit. Closed streams keep their payload until they "
+                   "are moved out of the flow tables, which only happens "
+                   "after every capture with incremental extraction.", 0);
+    config.addUInt("threads", "Extraction Threads",
+                   "Split the flows among this many threads (0 uses one "
+                   "thread per core). The streams do not depend on the number "
+                   "of threads, except for the ones closed by the limits of "
+                   "open streams and payload.", 1);
+    config.addBool("incremental", "Incremental Extraction",
+                   "Keep the streams open across the captures of the same "
+                   "traffic (e.g., rotated capture files). The captures are "
+                   "held until all of them arrive and are then processed in "
+                   "the order of their first packet. The streams closed in "
+                   "each capture are sent after it, the ones still open are "
+                   "sent with the last capture.", false);
+    config.addUInt("captures", "Number of Captures",
+                   "How many captures make up the traffic in incremental "
+                   "mode. The open streams are only sent once this many "
+                   "captures arrived (0 expects one capture per link into "
+                   "the node).", 0);
     config.addBool("dest_filter", "Should destination IPs be filtered?",
                    "Filter specifiying if IP addresses are filtered "
                    "for analysis.", false);
@@ -43,6 +104,14 @@ void CTcpStreamExtractorNode::configure(CNodeConfig &config)
     config.addUInt("dest_port_filter_to", "Last Valid Destination Port",
                    "Packages targeting a destination port below this "
                    "parameter are accepted", 1024);
+    config.addString("dest_networks", "Valid Destination Networks",
+                     "Comma separated list of networks in CIDR notation (e.g., "
+                     "10.0.0.0/8,192.168.1.0/24). Replaces the destination IP "
+                     "range when set.");
+    config.addString("dest_ports", "Valid Destination Ports",
+                     "Comma separated list of ports and port ranges (e.g., "
+                     "22,80,8000-8080). Replaces the destination port range "
+                     "when set.");
     config.setCategory("Extractor");
     // Add the gates.
     config.addInput("in", "tcpdump");
@@ -57,19 +126,45 @@ void CTcpStreamExtractorNode::configure(CNodeConfig &config)
 bool CTcpStreamExtractorNode::start()
 {
     // Get some user parameters.
-    QVariant payload_size = getConfig().getParameter("payload_size")->value;
-
-    // Create a new Data Structure that will hold all data streams.
-    m_tcp_streams = QSharedPointer<CTcpStreamsData>(
-                static_cast<CTcpStreamsData *>(createData("tcpstreams")));
-    m_tcp_streams->setMaxPayloadSize(payload_size.toUInt());
+    m_shards = getConfig().getParameter("threads")->value.toUInt();
+    if(m_shards == 0) {
+        m_shards = QThread::idealThreadCount();
+    }
+    // Shard numbers must fit in a byte (SKIP_PACKET is reserved).
+    m_shards = qBound(1, m_shards, static_cast<qint32>(SKIP_PACKET));
 
-    if(!m_tcp_streams.isNull()) {
-        return true;
+    m_incremental = getConfig().getParameter("incremental")->value.toBool();
+    if(!m_incremental &&
+       getConfig().getParameter("max_open_payload")->value.toUInt() > 0) {
+        logWarning("The closed TCP streams are only sent at the end of the "
+                   "capture, so their payload is not bounded by "
+                   "max_open_payload. Enable the incremental extraction to "
+                   "move them out after every capture.");
     }
-    else {
-        return false;
+    m_capture_count = getConfig().getParameter("captures")->value.toUInt();
+    if(m_capture_count == 0) {
+        m_capture_count = getInputCount("in");
     }
+    m_shard_streams.clear();
+    m_captures.clear();
+    m_packets = 0;
+
+    m_dest_filter = getConfig().getParameter("dest_filter")->value.toBool();
+    if(m_dest_filter) {
+        // Build the sets of destinations to keep.
+        m_dest_networks = CIpv4Set();
+        if(!m_dest_networks.add(destNetworks())) {
+            logError("Invalid list of destination networks.");
+            return false;
+        }
+        m_dest_ports = CPortSet();
+        if(!m_dest_ports.add(destPorts())) {
+            logError("Invalid list of destination ports.");
+            return false;
+        }
+    }
+
+    return true;
 }
 
 bool CTcpStreamExtractorNode::data(QString gate_name,
@@ -81,58 +176,260 @@ bool CTcpStreamExtractorNode::data(QString gate_name,
 
     if(data->getType() == "tcpdump") {
         auto tcp_dump = data.staticCast<const CTcpDumpData>();
+        if(!m_incremental) {
+            extract(tcp_dump, true);
+            return true;
+        }
 
-        // User parameters.
-        QHostAddress addr_from;
-        QHostAddress addr_to;
-        quint32 ip_from = 0;
-        quint32 ip_to = 0;
-        quint16 port_from = 0;
-        quint16 port_to = 0;
-
-        bool dest_filter = getConfig().getParameter("dest_filter")->value.toBool();
-        if(dest_filter) {
-            // Get the destination IP to ranges to filter.
-            QString dest_filter_from = getConfig().
-                    getParameter("dest_ip_filter_from")->value.toString();
-            QString dest_filter_to = getConfig().
-                    getParameter("dest_ip_filter_to")->value.toString();
-            addr_from = dest_filter_from;
-            addr_to = dest_filter_to;
-            ip_from = addr_from.toIPv4Address();
-            ip_to = addr_to.toIPv4Address();
-
-            // Get the destination port range to filter.
-            port_from = getConfig().
-                    getParameter("dest_port_filter_from")->value.toUInt();
-            port_to = getConfig().
-                    getParameter("dest_port_filter_to")->value.toUInt();
+        // Wait for all the captures of the traffic. They may arrive in any
+        // ... order, so they are sorted by the time of their first packet.
+        m_captures.append(tcp_dump);
+        if(m_captures.size() < m_capture_count) {
+            info = QString("Waiting for %1 more captures.")
+                    .arg(m_capture_count - m_captures.size());
+            logInfo(info);
+            return true;
         }
+        std::stable_sort(m_captures.begin(), m_captures.end(),
+            [] (const QSharedPointer<const CTcpDumpData> &capture1,
+                const QSharedPointer<const CTcpDumpData> &capture2) {
+                return startTime(*capture1) < startTime(*capture2);
+            });
+
+        QList<QSharedPointer<const CTcpDumpData>> captures;
+        captures.swap(m_captures);
+        for(qint32 i = 0; i < captures.size(); ++i) {
+            extract(captures.at(i), i == captures.size() - 1);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+QString CTcpStreamExtractorNode::inputFilter(QString gate_name) const
+{
+    Q_UNUSED(gate_name);
+
+    if(!getConfig().getParameter("dest_filter")->value.toBool()) {
+        return "tcp";
+    }
+
+    QString networks = destNetworks();
+    QString ports = destPorts();
+    if(networks.isEmpty() || ports.isEmpty()) {
+        // No destination is accepted.
+        return "tcp and not tcp";
+    }
+
+    return QString("tcp and dst net %1 and dst port %2").arg(networks, ports);
+}
+
+
+//------------------------------------------------------------------------------
+// Private Functions
+
+QString CTcpStreamExtractorNode::destNetworks() const
+{
+    QString networks = getConfig().getParameter("dest_networks")->value.toString();
+    if(!networks.isEmpty()) {
+        return networks.remove(' ');
+    }
+
+    QHostAddress addr_from(getConfig().
+            getParameter("dest_ip_filter_from")->value.toString());
+    QHostAddress addr_to(getConfig().
+            getParameter("dest_ip_filter_to")->value.toString());
+
+    // Cover the address range with the largest aligned networks.
+    QStringList nets;
+    quint64 address = addr_from.toIPv4Address();
+    quint64 address_end = addr_to.toIPv4Address();
+    while(address < address_end) {
+        quint32 bits = 0;
+        while(bits < 32 && (address & ((Q_UINT64_C(2) << bits) - 1)) == 0 &&
+              address + (Q_UINT64_C(2) << bits) <= address_end) {
+            ++bits;
+        }
+        nets.append(QString("%1/%2")
+                    .arg(QHostAddress(static_cast<quint32>(address)).toString())
+                    .arg(32 - bits));
+        address += Q_UINT64_C(1) << bits;
+    }
+
+    return nets.join(",");
+}
+
+QString CTcpStreamExtractorNode::destPorts() const
+{
+    QString ports = getConfig().getParameter("dest_ports")->value.toString();
+    if(!ports.isEmpty()) {
+        return ports.remove(' ');
+    }
+
+    quint32 port_from = getConfig().
+            getParameter("dest_port_filter_from")->value.toUInt();
+    quint32 port_to = qMin(getConfig().
+            getParameter("dest_port_filter_to")->value.toUInt(), 65535u);
+    if(port_from > port_to) {
+        return QString();
+    }
 
+    return QString("%1-%2").arg(port_from).arg(port_to);
+}
+
+void CTcpStreamExtractorNode::extract(
+        const QSharedPointer<const CTcpDumpData> &tcp_dump, bool final)
+{
+    QString info;
+
+    // Create the structures that follow the flows of each shard.
+    if(m_shard_streams.isEmpty()) {
+        for(qint32 i = 0; i < m_shards; ++i) {
+            auto tcp_streams = createStreamsData(m_shards);
+            if(tcp_streams.isNull()) {
+                m_shard_streams.clear();
+                commitError("out", "Could not create the TCP streams.");
+                return;
+            }
+            m_shard_streams.append(tcp_streams);
+        }
+    }
+
+    if(m_shards == 1) {
+        CTcpStreamsData &tcp_streams = *m_shard_streams.first();
         qint32 packet_count = tcp_dump->availablePackets();
         for(qint32 i = 0; i < packet_count; ++i) {
             QSharedPointer<const CTcpDumpPacket> packet = tcp_dump->getPacket(i);
-            if(dest_filter) {
-                if(packet->dest() < ip_from || packet->dest() >= ip_to ||
-                   packet->dest_port() < port_from ||
-                   packet->dest_port() > port_to) {
-                    // Skip this package as it's outside the filter range.
-                    continue;
-                }
+            if(acceptPacket(*packet)) {
+                tcp_streams.addTcpPacket(packet, m_packets + i);
+            }
+        }
+    }
+    else {
+        extractStreams(tcp_dump);
+    }
+    m_packets += tcp_dump->availablePackets();
+
+    // Gather the streams to send.
+    QSharedPointer<CTcpStreamsData> tcp_streams;
+    if(final && m_shard_streams.size() == 1) {
+        tcp_streams = m_shard_streams.first();
+    }
+    else {
+        tcp_streams = createStreamsData(1);
+        if(tcp_streams.isNull()) {
+            commitError("out", "Could not create the TCP streams.");
+            return;
+        }
+        for(auto &shard_streams : m_shard_streams) {
+            if(final) {
+                tcp_streams->merge(*shard_streams);
+            }
+            else {
+                // Only send the streams that will not change anymore.
+                shard_streams->moveClosedStreams(*tcp_streams);
             }
-            m_tcp_streams->addTcpPacket(packet);
         }
+    }
+    tcp_streams->setFinal(final);
+    if(final) {
+        // Start from scratch if more inputs arrive.
+        m_shard_streams.clear();
+        m_packets = 0;
+    }
 
-        info = "TCP streams left open: " + QVariant(m_tcp_streams->openStreamsCount()).toString();
-        logInfo(info);
-        info = "TCP streams closed: " + QVariant(m_tcp_streams->closedStreamsCount()).toString();
-        logInfo(info);
+    info = "TCP streams left open: " + QVariant(tcp_streams->openStreamsCount()).toString();
+    logInfo(info);
+    info = "TCP streams closed: " + QVariant(tcp_streams->closedStreamsCount()).toString();
+    logInfo(info);
+    info = "TCP streams timed out: " + QVariant(tcp_streams->timedOutStreamsCount()).toString();
+    logInfo(info);
+    info = "TCP streams evicted: " + QVariant(tcp_streams->evictedStreamsCount()).toString();
+    logInfo(info);
+    info = QString("TCP payload held (KB): %1 open, %2 closed")
+            .arg(tcp_streams->openPayload() >> 10)
+            .arg(tcp_streams->closedPayload() >> 10);
+    logInfo(info);
 
-        commit("out", m_tcp_streams);
-        // Clear the memory used by m_tcp_streams.
-        m_tcp_streams.clear();
-        return true;
+    commit("out", tcp_streams);
+}
+
+QSharedPointer<CTcpStreamsData> CTcpStreamExtractorNode::createStreamsData(
+        qint32 shards)
+{
+    QVariant payload_size = getConfig().getParameter("payload_size")->value;
+    QVariant idle_timeout = getConfig().getParameter("idle_timeout")->value;
+    QVariant active_timeout = getConfig().getParameter("active_timeout")->value;
+    QVariant max_open_streams = getConfig().getParameter("max_open_streams")->value;
+    QVariant max_open_payload = getConfig().getParameter("max_open_payload")->value;
+
+    auto tcp_streams = QSharedPointer<CTcpStreamsData>(
+                static_cast<CTcpStreamsData *>(createData("tcpstreams")));
+    if(tcp_streams.isNull()) {
+        return tcp_streams;
     }
 
-    return false;
+    // The limits of the open streams are split among the shards.
+    quint32 max_streams = max_open_streams.toUInt();
+    quint64 max_payload = static_cast<quint64>(max_open_payload.toUInt()) << 20;
+    if(max_streams > 0) {
+        max_streams = qMax(max_streams / shards, 1u);
+    }
+    if(max_payload > 0) {
+        max_payload = qMax(max_payload / shards, Q_UINT64_C(1));
+    }
+
+    tcp_streams->setMaxPayloadSize(payload_size.toUInt());
+    tcp_streams->setIdleTimeout(idle_timeout.toUInt());
+    tcp_streams->setActiveTimeout(active_timeout.toUInt());
+    tcp_streams->setMaxOpenStreams(max_streams);
+    tcp_streams->setMaxOpenPayload(max_payload);
+
+    return tcp_streams;
+}
+
+void CTcpStreamExtractorNode::extractStreams(
+        const QSharedPointer<const CTcpDumpData> &tcp_dump)
+{
+    qint32 packet_count = tcp_dump->availablePackets();
+
+    // Assign each packet to the shard of its flow. Both directions of a
+    // ... connection go to the same shard.
+    QVector<quint8> packet_shards(packet_count);
+    QVector<double> packet_times(packet_count);
+    QVector<QPair<qint32, qint32>> ranges;
+    const qint32 range_size = 65536;
+    for(qint32 i = 0; i < packet_count; i += range_size) {
+        ranges.append(qMakePair(i, qMin(i + range_size, packet_count)));
+    }
+    QtConcurrent::blockingMap(ranges, [&] (const QPair<qint32, qint32> &range) {
+        for(qint32 i = range.first; i < range.second; ++i) {
+            QSharedPointer<const CTcpDumpPacket> packet = tcp_dump->getPacket(i);
+            if(packet->tcp && acceptPacket(*packet)) {
+                packet_shards[i] = CTcpKey(packet).symmetricHash() % m_shards;
+                packet_times[i] = packet->time;
+            }
+            else {
+                packet_shards[i] = SKIP_PACKET;
+            }
+        }
+    });
+
+    // Each shard follows its own flows in its own thread.
+    QVector<qint32> shard_ids;
+    for(qint32 i = 0; i < m_shards; ++i) {
+        shard_ids.append(i);
+    }
+    QtConcurrent::blockingMap(shard_ids, [&] (const qint32 &shard) {
+        CTcpStreamsData &tcp_streams = *m_shard_streams[shard];
+        for(qint32 i = 0; i < packet_count; ++i) {
+            if(packet_shards[i] == shard) {
+                tcp_streams.addTcpPacket(tcp_dump->getPacket(i), m_packets + i);
+            }
+            else if(packet_shards[i] != SKIP_PACKET) {
+                tcp_streams.advanceTime(packet_times[i], m_packets + i);
+            }
+        }
+    });
 }
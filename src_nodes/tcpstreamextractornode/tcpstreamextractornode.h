@@ -4,8 +4,12 @@
 #include "node/node.h"
 #include "node/nodeconfig.h"
 #include "tcpstreamsdata/tcpstreamsdata.h"
+#include "tcpdumpdata/tcpdumpdata.h"
+#include "tcpdumpdata/networkset.h"
+#include <QList>
 #include <QObject>
 #include <QString>
+#include <QVector>
 
 
 class CTcpStreamExtractorNode: public CNode
@@ -13,8 +17,27 @@ class CTcpStreamExtractorNode: public CNode
     Q_OBJECT
 
 private:
+    // Shard marking packets that are not assigned to any shard.
+    static const quint8 SKIP_PACKET = 0xff;
+
     // Data Structures
-    QSharedPointer<CTcpStreamsData> m_tcp_streams;
+    // The streams followed by each shard.
+    QVector<QSharedPointer<CTcpStreamsData>> m_shard_streams;
+    // Number of shards (and threads) the flows are split into.
+    qint32 m_shards;
+    // Keep the streams open across inputs.
+    bool m_incremental;
+    // The captures that make up the traffic in incremental mode and the ones
+    // ... received so far, which wait until all of them are here.
+    qint32 m_capture_count;
+    QList<QSharedPointer<const CTcpDumpData>> m_captures;
+    // Packets extracted since the last final commit. Packets are numbered
+    // ... from the first one of the first capture.
+    qint64 m_packets;
+    // Destination filter.
+    bool m_dest_filter;
+    CIpv4Set m_dest_networks;
+    CPortSet m_dest_ports;
 
 public:
     // Constructor
@@ -27,7 +50,37 @@ protected:
     virtual bool start();
     // Receive data sent by other nodes connected to this node.
     virtual bool data(QString gate_name, const CConstDataPointer &data);
+    // Only TCP packets passing the destination filter are needed.
+    virtual QString inputFilter(QString gate_name) const;
+
+private:
+    // Follow the streams of a capture and commit the ones that will not
+    // ... change anymore, or all of them if the capture is the 'final' one.
+    void extract(const QSharedPointer<const CTcpDumpData> &tcp_dump,
+                 bool final);
+    // Create a streams structure configured with the user parameters. The
+    // ... limits of open streams are divided by 'shards'.
+    QSharedPointer<CTcpStreamsData> createStreamsData(qint32 shards);
+    // Add the packets to the streams of the shards in parallel, one shard per
+    // ... thread. Every shard sees the time of all the packets, so idle
+    // ... streams are closed as if there was a single shard.
+    void extractStreams(const QSharedPointer<const CTcpDumpData> &tcp_dump);
+    // The destination networks and ports to keep as comma separated lists.
+    QString destNetworks() const;
+    QString destPorts() const;
+    // Does the packet pass the destination filter?
+    inline bool acceptPacket(const CTcpDumpPacket &packet) const;
 };
 
+bool CTcpStreamExtractorNode::acceptPacket(const CTcpDumpPacket &packet) const
+{
+    if(!m_dest_filter) {
+        return true;
+    }
+
+    return m_dest_networks.contains(packet.dest()) &&
+           m_dest_ports.contains(packet.dest_port());
+}
+
 #endif // TCPSTREAMEXTRACTORNODE_H
 
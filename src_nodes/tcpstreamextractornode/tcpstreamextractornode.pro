@@ -1,5 +1,6 @@
 QT += core
 QT += network
+QT += concurrent
 QT -= gui
 
 TARGET = tcpstreamextractornode
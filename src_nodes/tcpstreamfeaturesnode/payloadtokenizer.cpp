@@ -0,0 +1,166 @@
+#include "payloadtokenizer.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__SSE2__))
+#define PAYLOADTOKENIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    inline bool plain(uchar c)
+    {
+        return c > ' ' && c <= '~' && c != '^';
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CPayloadTokenizer::CPayloadTokenizer(quint32 word_count, quint32 word_length,
+                                     CStringPool &pool)
+    : m_word_count(qMin(word_count, 1u << 16))
+    , m_capacity(qMin(word_length, 1u << 16) + 1)
+    , m_pool(pool)
+    , m_padding(".")
+    , m_word(m_capacity + 1, QChar('.'))
+    , m_length(0)
+    , m_row(nullptr)
+    , m_missing(0)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+void CPayloadTokenizer::tokenize(const CTcpStream &stream, QList<QVariant> &row)
+{
+    m_row = &row;
+    m_missing = m_word_count;
+    m_length = 0;
+
+    // The payload is read segment by segment, the gaps between them are
+    // ... zeros.
+    quint32 position = 0;
+    bool reading = m_missing > 0;
+    for(const CTcpSegment &segment : stream.segments) {
+        if(!reading) {
+            break;
+        }
+        if(segment.offset > position) {
+            reading = readZeros(segment.offset - position);
+        }
+        if(reading) {
+            reading = read(segment.data.constData() + segment.start,
+                           segment.length);
+        }
+        position = segment.end();
+    }
+    if(reading && stream.payload_end > position) {
+        reading = readZeros(stream.payload_end - position);
+    }
+
+    // The last word has no leading '.'.
+    if(m_missing > 0 && m_length > 0) {
+        row << m_pool.store(m_word.constData() + 1, m_length);
+        --m_missing;
+    }
+
+    for(; m_missing > 0; --m_missing) {
+        row << m_padding;
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Private Functions
+
+bool CPayloadTokenizer::read(const uchar *data, qint32 length)
+{
+    qint32 i = 0;
+    while(i < length) {
+        // Copy the characters that need no escaping in one go.
+        qint32 count = plainBytes(data + i, length - i);
+        if(count > 0) {
+            qint32 copied = qMin(count, m_capacity - m_length);
+            for(qint32 j = 0; j < copied; ++j) {
+                m_word[m_length + 1 + j] = QChar(data[i + j]);
+            }
+            m_length += copied;
+            i += count;
+            continue;
+        }
+
+        uchar c = data[i++];
+        if(c > '~' || c == ' ') {
+            // Treat any non-printable character as a word separator.
+            if(m_length > 0) {
+                endWord();
+            }
+        }
+        else if(c == '\n') {
+            append('^');
+            endWord();
+        }
+        else {
+            // Escape '^' and the control characters (e.g., "^@" for 0).
+            append('^');
+            append(QChar(c + 64));
+        }
+
+        if(m_missing == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CPayloadTokenizer::readZeros(qint32 count)
+{
+    // Zeros never end a word, only the characters kept matter.
+    for(qint32 i = 0; i < count && m_length < m_capacity; ++i) {
+        append('^');
+        append('@');
+    }
+
+    return true;
+}
+
+qint32 CPayloadTokenizer::plainBytes(const uchar *data, qint32 length)
+{
+    qint32 i = 0;
+
+#ifdef PAYLOADTOKENIZER_SSE2
+    // Classify 16 bytes at a time. The bytes are moved to the signed range
+    // ... so that the printable ones can be found with signed comparisons.
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i space = _mm_set1_epi8(static_cast<char>(' ' ^ 0x80));
+    const __m128i del = _mm_set1_epi8(static_cast<char>(127 ^ 0x80));
+    const __m128i caret = _mm_set1_epi8('^');
+    for(; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i biased = _mm_xor_si128(bytes, bias);
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(biased, space),
+                                          _mm_cmplt_epi8(biased, del));
+        __m128i plain = _mm_andnot_si128(_mm_cmpeq_epi8(bytes, caret), printable);
+        quint32 special = ~_mm_movemask_epi8(plain) & 0xffff;
+        if(special != 0) {
+            return i + __builtin_ctz(special);
+        }
+    }
+#endif
+
+    for(; i < length && plain(data[i]); ++i);
+
+    return i;
+}
+
+void CPayloadTokenizer::endWord()
+{
+    // The word with its leading '.'.
+    m_row->append(m_pool.store(m_word.constData(), qMin(m_length + 1, m_capacity)));
+    m_length = 0;
+    --m_missing;
+}
@@ -0,0 +1,64 @@
+#ifndef PAYLOADTOKENIZER_H
+#define PAYLOADTOKENIZER_H
+
+#include "tcpstreamsdata/tcpstream.h"
+#include "stringpool.h"
+#include <QList>
+#include <QVariant>
+#include <QVector>
+
+
+// Split the payload of a TCP stream into the words used as features. Words
+// ... end at spaces, bytes above '~' and line breaks (kept as '^'). Other
+// ... control characters and '^' are escaped with a '^'. Every word starts
+// ... with a '.' (but the last one when the payload ends inside a word) and
+// ... is cut to 'word_length' characters.
+class CPayloadTokenizer
+{
+  private:
+    qint32 m_word_count;
+    // Characters kept of each word, including the leading '.'.
+    qint32 m_capacity;
+    CStringPool &m_pool;
+    // The word used to pad the rows.
+    QString m_padding;
+    // The word being read, after a '.' at position 0.
+    QVector<QChar> m_word;
+    qint32 m_length;
+    // Where the words go and how many are still missing.
+    QList<QVariant> *m_row;
+    qint32 m_missing;
+
+  public:
+    // The words are taken from 'pool', so repeated words share their
+    // ... characters.
+    explicit CPayloadTokenizer(quint32 word_count, quint32 word_length,
+                               CStringPool &pool);
+    // Append the first 'word_count' words of the payload to 'row', padded
+    // ... with "." if the payload has fewer words.
+    void tokenize(const CTcpStream &stream, QList<QVariant> &row);
+
+  private:
+    // Read 'length' bytes of payload. Return false once all the words have
+    // ... been found.
+    bool read(const uchar *data, qint32 length);
+    // Read 'count' zero bytes (payload that was never stored).
+    bool readZeros(qint32 count);
+    // Count the bytes at 'data' that can be copied into a word as they are.
+    static qint32 plainBytes(const uchar *data, qint32 length);
+    inline void append(QChar c);
+    void endWord();
+};
+
+
+// Inline functions
+
+void CPayloadTokenizer::append(QChar c)
+{
+    // Characters past the capacity are dropped.
+    if(m_length < m_capacity) {
+        m_word[++m_length] = c;
+    }
+}
+
+#endif // PAYLOADTOKENIZER_H
@@ -0,0 +1,34 @@
+#include "stringpool.h"
+
+
+//------------------------------------------------------------------------------
+// Constructor and Destructor
+
+CStringPool::CStringPool()
+    : m_strings()
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+// Public Functions
+
+QString CStringPool::store(const QChar *chars, qint32 length)
+{
+    if(length <= 0) {
+        return QString();
+    }
+
+    // Look the characters up without copying them. Only the strings in the
+    // ... set are handed out.
+    auto it = m_strings.constFind(QString::fromRawData(chars, length));
+    if(it != m_strings.constEnd()) {
+        return *it;
+    }
+
+    QString string(chars, length);
+    m_strings.insert(string);
+
+    return string;
+}
@@ -0,0 +1,23 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QChar>
+#include <QSet>
+#include <QString>
+
+
+// A set of strings that hands out a single copy of every distinct string.
+// ... The strings own their characters and are implicitly shared, so they
+// ... stay valid after the pool is gone.
+class CStringPool
+{
+  private:
+    QSet<QString> m_strings;
+
+  public:
+    explicit CStringPool();
+    // The string with the 'length' characters at 'chars'.
+    QString store(const QChar *chars, qint32 length);
+};
+
+#endif // STRINGPOOL_H
@@ -1,9 +1,10 @@
 #include "tcpstreamfeaturesnode.h"
 #include "data/datafactory.h"
 #include "data/messagedata.h"
-#include <ctime>
 #include <QDebug>
-#include <QDateTime>
+#include <QPair>
+#include <QVector>
+#include <QtConcurrent>
 #include <tabledata/tabledata.h>
 #include <tcpstreamsdata/tcpstreamsdata.h>
 
@@ -14,6 +15,16 @@
 CTcpStreamFeaturesNode::CTcpStreamFeaturesNode(const CNodeConfig &config, QObject *parent/* = 0*/)
     : CNode(config, parent)
     , m_processed_streams(0)
+    , m_timestamp(false)
+    , m_timezone(0)
+    , m_split_dest_ip(false)
+    , m_dest_ip_octets(4)
+    , m_split_src_ip(false)
+    , m_src_ip_octets(4)
+    , m_word_count(0)
+    , m_word_length(0)
+    , m_packet_count(false)
+    , m_numeric(false)
 {
 
 }
@@ -50,6 +61,10 @@ void CTcpStreamFeaturesNode::configure(CNodeConfig &config)
     config.addBool("packet_count", "Show Packet Count",
                    "Include the total number of packets parsed by the stream.", false);
 
+    config.addBool("numeric", "Numeric Features",
+                   "Keep timestamps, addresses, octets and flags as numbers. "
+                   "They are formatted when the table is written out.", false);
+
     // Add the gates.
     config.addInput("in", "tcpstreams");
     config.addOutput("out", "table");
@@ -61,6 +76,21 @@ void CTcpStreamFeaturesNode::configure(CNodeConfig &config)
 
 bool CTcpStreamFeaturesNode::start()
 {
+    // Resolve the parameters once, they are read for every stream.
+    const CNodeConfig &config = getConfig();
+    m_timestamp = config.getParameter("timestamp")->value.toBool();
+    // Timezone parameter is in hours, we need it in seconds.
+    m_timezone = config.getParameter("timezone")->value.toInt() * 3600;
+    m_split_dest_ip = config.getParameter("split_dest_ip")->value.toBool();
+    m_dest_ip_octets = qBound(1, config.getParameter("dest_ip_split_number")->value.toInt(), 4);
+    m_split_src_ip = config.getParameter("split_src_ip")->value.toBool();
+    m_src_ip_octets = qBound(1, config.getParameter("src_ip_split_number")->value.toInt(), 4);
+    m_word_count = config.getParameter("word_count")->value.toUInt();
+    m_word_length = config.getParameter("word_length")->value.toUInt();
+    m_packet_count = config.getParameter("packet_count")->value.toBool();
+    m_numeric = config.getParameter("numeric")->value.toBool();
+    m_processed_streams = 0;
+
     return createFeaturesTable();
 }
 
@@ -71,50 +101,66 @@ bool CTcpStreamFeaturesNode::data(QString gate_name, const CConstDataPointer &da
     if(data->getType() == "tcpstreams") {
         auto tcp_streams = data.staticCast<const CTcpStreamsData>();
 
-        // Progress reporting things.
-        qint32 progress = 0;
-        qint32 progress_total = tcp_streams->totalStreamsCount();
-        qint32 progress_step = progress_total / 100;
+        // The closed streams go first, then the open streams.
+        QList<CTcpStream*> streams = tcp_streams->getClosedStreams();
+        streams.append(tcp_streams->getOpenStreams());
+        qint32 stream_count = streams.size();
         setProgress(0);
 
         // Optimize the row allocation space for the table.
-        m_table->reserveRows(m_table->rowCount() +
-                             tcp_streams->totalStreamsCount());
-
-        // Process the closed streams.
-        QList<CTcpStream*> closed_streams = tcp_streams->getClosedStreams();
-        auto closed_streams_it = closed_streams.begin();
-        for(; closed_streams_it != closed_streams.end(); ++closed_streams_it) {
-            CTcpStream* stream = *closed_streams_it;
-            extractFeatures(*stream);
-            // Report progress every so often.
-            ++progress;
-            if(progress % 10000 == 0) {
-                setProgress(static_cast<qint64>(progress) * 100 /
-                            static_cast<qint64>(progress_total));
+        m_table->reserveRows(m_table->rowCount() + stream_count);
+
+        // Extract the features of blocks of streams spread among the threads.
+        // ... Each block has its own rows, which are appended in order once
+        // ... the batch is done so that the table keeps the stream order.
+        const qint32 block_size = 1024;
+        const qint32 batch_size = block_size * 64;
+        // Every block of a batch takes its words from its own pool.
+        QVector<CStringPool> pools(batch_size / block_size);
+        for(qint32 batch = 0; batch < stream_count; batch += batch_size) {
+            qint32 batch_end = qMin(batch + batch_size, stream_count);
+            QVector<QPair<qint32, qint32>> blocks;
+            for(qint32 i = batch; i < batch_end; i += block_size) {
+                blocks.append(qMakePair(i, qMin(i + block_size, batch_end)));
             }
-        }
-        // Process the open streams.
-        QList<CTcpStream*> open_streams = tcp_streams->getOpenStreams();
-        auto open_streams_it = open_streams.begin();
-        for(; open_streams_it != open_streams.end(); ++open_streams_it) {
-            CTcpStream* stream = *open_streams_it;
-            extractFeatures(*stream);
-            // Report progress every so often.
-            ++progress;
-            if(progress % progress_step == 0) {
-                setProgress(static_cast<qint64>(progress) * 100 /
-                            static_cast<qint64>(progress_total));
+            QVector<QList<QList<QVariant>>> rows(blocks.size());
+
+            QtConcurrent::blockingMap(blocks, [&] (const QPair<qint32, qint32> &block) {
+                qint32 index = (block.first - batch) / block_size;
+                QList<QList<QVariant>> &block_rows = rows[index];
+                CPayloadTokenizer tokenizer(m_word_count, m_word_length,
+                                            pools[index]);
+                block_rows.reserve(block.second - block.first);
+                for(qint32 i = block.first; i < block.second; ++i) {
+                    block_rows.append(QList<QVariant>());
+                    extractFeatures(*streams.at(i), tokenizer, block_rows.last());
+                }
+            });
+
+            for(qint32 i = 0; i < blocks.size(); ++i) {
+                m_table->appendRows(rows.at(i));
             }
+
+            // Report progress every so often.
+            setProgress(static_cast<qint64>(batch_end) * 90 / stream_count);
         }
 
-        ++m_processed_streams;
+        // Incremental extractors send several partial sets of streams.
+        if(tcp_streams->isFinal()) {
+            ++m_processed_streams;
+        }
 
         if(m_processed_streams == getInputCount("in")) {
             // We have processed all the streams. Commit and finish.
-            // Sort by date and then time (fields 0 and 1).
             setProgress(95);
-            m_table->sort(0, 1);
+            if(m_numeric) {
+                // Sort by the timestamp (field 0).
+                m_table->sort(0);
+            }
+            else {
+                // Sort by date and then time (fields 0 and 1).
+                m_table->sort(0, 1);
+            }
             // Commit.
             commit("out", m_table);
             // Free memory when the table is no longer in use.
@@ -135,8 +181,23 @@ bool CTcpStreamFeaturesNode::createFeaturesTable()
                 static_cast<CTableData *>(createData("table")));
 
     if(!m_table.isNull()) {
+        // Numeric columns are formatted when the table is written out.
+        CTableData::EFormat address_format = CTableData::EFormat::raw;
+        CTableData::EFormat octet_format = CTableData::EFormat::raw;
+        CTableData::EFormat flags_format = CTableData::EFormat::raw;
+        if(m_numeric) {
+            address_format = CTableData::EFormat::ipv4;
+            octet_format = CTableData::EFormat::octet;
+            flags_format = CTableData::EFormat::tcp_flags;
+        }
+
         // Set the table headers at the same time.
-        if(!getConfig().getParameter("timestamp")->value.toBool()) {
+        if(m_numeric) {
+            m_table->addHeader("Timestamp", m_timestamp ?
+                                   CTableData::EFormat::raw :
+                                   CTableData::EFormat::datetime);
+        }
+        else if(!m_timestamp) {
             m_table->addHeader("Date");
             m_table->addHeader("Time");
         }
@@ -145,35 +206,31 @@ bool CTcpStreamFeaturesNode::createFeaturesTable()
         }
 
         // Total Packets
-        if(getConfig().getParameter("packet_count")->value.toBool()) {
+        if(m_packet_count) {
             m_table->addHeader(QString("Packets"));
         }
 
         // DEST IP
-        if(getConfig().getParameter("split_dest_ip")->value.toBool()) {
-            qint32 length = getConfig().
-                    getParameter("dest_ip_split_number")->value.toInt();
-            for(qint32 i = length - 1; i >= 0; --i) {
-                m_table->addHeader(QString("DA%1").arg(i));
+        if(m_split_dest_ip) {
+            for(qint32 i = m_dest_ip_octets - 1; i >= 0; --i) {
+                m_table->addHeader(QString("DA%1").arg(i), octet_format);
             }
         }
         else {
-            m_table->addHeader("DA");
+            m_table->addHeader("DA", address_format);
         }
 
         // Destination Port
         m_table->addHeader("DP");
 
         // SRC IP
-        if(getConfig().getParameter("split_src_ip")->value.toBool()) {
-            qint32 length = getConfig().
-                    getParameter("src_ip_split_number")->value.toInt();
-            for(qint32 i = length - 1; i >= 0; --i) {
-                m_table->addHeader(QString("SA%1").arg(i));
+        if(m_split_src_ip) {
+            for(qint32 i = m_src_ip_octets - 1; i >= 0; --i) {
+                m_table->addHeader(QString("SA%1").arg(i), octet_format);
             }
         }
         else {
-            m_table->addHeader("SA");
+            m_table->addHeader("SA", address_format);
         }
 
         // Source Port
@@ -183,16 +240,15 @@ bool CTcpStreamFeaturesNode::createFeaturesTable()
         m_table->addHeader("DUR");
 
         // The first flags, second to last and last flags.
-        m_table->addHeader("F1");
-        m_table->addHeader("F2");
-        m_table->addHeader("F3");
+        m_table->addHeader("F1", flags_format);
+        m_table->addHeader("F2", flags_format);
+        m_table->addHeader("F3", flags_format);
 
         // The size of the data.
         m_table->addHeader("LEN");
 
         // WORDS
-        qint32 words = getConfig().getParameter("word_count")->value.toInt();
-        for(qint32 i = 1; i <= words; ++i) {
+        for(quint32 i = 1; i <= m_word_count; ++i) {
             m_table->addHeader(QString("W%1").arg(i));
         }
 
@@ -203,185 +259,94 @@ bool CTcpStreamFeaturesNode::createFeaturesTable()
     }
 }
 
-void CTcpStreamFeaturesNode::extractFeatures(const CTcpStream &tcp_stream)
+void CTcpStreamFeaturesNode::extractFeatures(const CTcpStream &tcp_stream,
+                                             CPayloadTokenizer &tokenizer,
+                                             QList<QVariant> &row) const
 {
-    QList<QVariant> &row = m_table->newRow();
-
     // The Attributes being added:
     // DATE TIME DEST_IP DEST_PORT SRC_IP SRC_PORT DUR F1 F2 F3 LEN W1 ... W8
+    row.reserve(m_table->headerSize());
 
     // Date & Time
-    QVariant timestamp = getConfig().getParameter("timestamp")->value;
-    QVariant timezone_offset = getConfig().getParameter("timezone")->value;
-    if(!timestamp.toBool()) {
+    qint64 seconds = static_cast<quint32>(tcp_stream.start_time);
+    seconds += m_timezone;
+    if(m_numeric && !m_timestamp) {
+        // Seconds since the epoch, formatted when written out.
+        row << seconds;
+    }
+    else if(!m_timestamp) {
         // Do not use timestamps, use formatted dates.
-        QDateTime datetime;
-        // Timezone parameter is in hours, we need it in seconds.
-        datetime.setOffsetFromUtc(timezone_offset.toInt() * 3600);
-        datetime.setTime_t(tcp_stream.start_time);
-        QString time_string = datetime.toString(QString("MM/dd/yyyy hh:mm:ss"));
-        QStringList split_time = time_string.split(" ");
-        // Append time.
-        row << split_time.at(0);//DATE
-        row << split_time.at(1);//TIME
+        QString date, time;
+        CTableData::formatDateTime(seconds, date, time);
+        row << date;
+        row << time;
     }
     else {
-        // Use timestamps only.
-        row << tcp_stream.start_time + timezone_offset.toInt() * 3600;
+        // Use timestamps only, with their fraction of a second.
+        row << tcp_stream.start_time + m_timezone;
     }
 
     // The number of packets in the stream
-    bool packet_count = getConfig().getParameter("packet_count")->value.toBool();
-    if(packet_count) {        
+    if(m_packet_count) {
         row << tcp_stream.total_packets;
     }
 
     // Destination Address
-    QVariant split_dest = getConfig().getParameter("split_dest_ip")->value;
-    if(split_dest.toBool()) {
-        // Split each octet of the destination addrs as a different attribute.
-        QVariant dest_octets = getConfig().
-                getParameter("dest_ip_split_number")->value;
-        qint32 bits = 24 - ((4 - dest_octets.toInt()) * 8);
-        for(qint32 i = bits; i >= 0; i -= 8) {
-            qint32 octet = (tcp_stream.destination_addr >> i) & 0xFF;
-            // Path the octet with 0s to make its length 3.
-            QString octet_string = QString("%1").arg(octet, 3, 10, QChar('0'));
-            // Append an octet.
-            row << octet_string;
-        }
-    }
-    else {
-        unsigned char octet[4] = {0, 0, 0, 0};
-        for(int i = 0; i < 4; ++i) {
-            octet[i] = (tcp_stream.destination_addr >> (i * 8)) & 0xFF;
-        }
-        row << QString("%1.%2.%3.%4").
-               arg(QString::number(octet[3])).
-               arg(QString::number(octet[2])).
-               arg(QString::number(octet[1])).
-               arg(QString::number(octet[0]));
-    }
+    appendAddress(tcp_stream.destination_addr, m_split_dest_ip,
+                  m_dest_ip_octets, row);
 
     // Destination Port
     row << tcp_stream.destination_port;
 
     // Source Address
-    QVariant split_src = getConfig().getParameter("split_src_ip")->value;
-    if(split_src.toBool()) {
-        // Split each octet of the source addrs as different attributes.
-        QVariant src_octets = getConfig().getParameter("src_ip_split_number")->value;
-        qint32 bits = 24 - ((4 - src_octets.toInt()) * 8);
-        for(qint32 i = bits; i >= 0; i -= 8) {
-            qint32 octet = (tcp_stream.source_addr >> i) & 0xFF;
-            // Path the octet with 0s to make its length 3.
-            QString octet_string = QString("%1").arg(octet, 3, 10, QChar('0'));
-            // Append an octet.
-            row << octet_string;
-        }
-    }
-    else {
-        unsigned char octet[4] = {0, 0, 0, 0};
-        for(int i = 0; i < 4; ++i) {
-            octet[i] = (tcp_stream.source_addr >> (i * 8)) & 0xFF;
-        }
-        row << QString("%1.%2.%3.%4").
-               arg(QString::number(octet[3])).
-               arg(QString::number(octet[2])).
-               arg(QString::number(octet[1])).
-               arg(QString::number(octet[0]));
-    }
+    appendAddress(tcp_stream.source_addr, m_split_src_ip, m_src_ip_octets, row);
 
     // Source Port
     row << tcp_stream.source_port;
 
     // Stream duration (in seconds)
     row << static_cast<qint32>(tcp_stream.finish_time - tcp_stream.start_time);
-    //qDebug() << "S"<<tcp_stream.start_time;
-    //qDebug() << "F"<<tcp_stream.finish_time;
     // The first flags, second to last and last flags.
-    row << buildFlagsString(tcp_stream.flags_first);
-    row << buildFlagsString(tcp_stream.flags_before_last);
-    row << buildFlagsString(tcp_stream.flags_last);
+    if(m_numeric) {
+        // QVariant keeps 8 bit values as characters, store the bits as uint.
+        row << static_cast<quint32>(tcp_stream.flags_first);
+        row << static_cast<quint32>(tcp_stream.flags_before_last);
+        row << static_cast<quint32>(tcp_stream.flags_last);
+    }
+    else {
+        row << CTableData::formatTcpFlags(tcp_stream.flags_first);
+        row << CTableData::formatTcpFlags(tcp_stream.flags_before_last);
+        row << CTableData::formatTcpFlags(tcp_stream.flags_last);
+    }
 
     // The size of the data.
-    //qDebug()<<"DL" <<tcp_stream.data_length;
     row << tcp_stream.data_length;
 
     // The words to extract from the data stream.
-    QStringList string_list = extractStrings(tcp_stream.payload);
-    for(int i = 0; i < string_list.size(); ++i) {
-        row << string_list.at(i);
-    }
-}
-
-QString CTcpStreamFeaturesNode::buildFlagsString(quint8 flags)
-{
-    QString str(".");
-    if(flags & 128) str.append('1');
-    if(flags & 64) str.append('0');
-    if(flags & 32) str.append('U');
-    if(flags & 16) str.append('A');
-    if(flags & 8) str.append('P');
-    if(flags & 4) str.append('R');
-    if(flags & 2) str.append('S');
-    if(flags & 1) str.append('F');
-
-    return str;
+    tokenizer.tokenize(tcp_stream, row);
 }
 
-QStringList CTcpStreamFeaturesNode::extractStrings(const QVector<quint8> &data)
+void CTcpStreamFeaturesNode::appendAddress(quint32 address, bool split,
+                                           qint32 octets, QList<QVariant> &row) const
 {
-    QStringList strings;
-    QString string("");
-    QVariant limit_param = getConfig().getParameter("word_count")->value;
-    quint32 word_length = getConfig().getParameter("word_length")->value.toUInt();
-    quint32 limit = limit_param.toUInt();
-
-    // Extract up to 'limit' strings.
-    for(qint32 i = 0; i < data.size() && limit > 0; ++i) {
-        // Found a space, null byte or non-printable char and there is a word?
-        if(data[i] > '~' || data[i] == ' ')
-        {
-            // Treat any non-printable character as a word separators.
-            if(!string.isEmpty()) {
-                // Add the word to the list and reset the string.
-                string.push_front('.'); // Every string starts with a '.'
-                strings << string.left(word_length + 1);
-                --limit;
-                string = "";
-            }
-        }
-        // Found a line break.
-        else if(data[i] == '\n') {
-            string.append("^");
-            string.push_front('.');
-            strings << string.left(word_length + 1);
-            --limit;
-            string = "";
-        }
-        // If character is unprintable add a ^ and make it printable.
-        else if(data[i] < ' ' || data[i] == '^') {
-            string.append('^');
-            string.append(static_cast<char>(data[i] + 64));
+    if(!split) {
+        if(m_numeric) {
+            row << address;
         }
         else {
-            // Add the printable character to the current string.
-            string.append(static_cast<char>(data[i]));
+            row << CTableData::formatAddress(address);
         }
+        return;
     }
 
-    // Add any printable characters still remaining.
-    if(limit > 0 && !string.isEmpty()) {
-        strings << string.left(word_length + 1);
-        --limit;
-    }
-
-    // Add empty strings until we reach the limit.
-    for(; limit > 0; --limit) {
-        strings << ".";
+    // Start with the most significant octet used.
+    for(qint32 i = (octets - 1) * 8; i >= 0; i -= 8) {
+        quint32 octet = (address >> i) & 0xFF;
+        if(m_numeric) {
+            row << octet;
+        }
+        else {
+            row << CTableData::formatOctet(octet);
+        }
     }
-
-    return strings;
 }
-
@@ -4,6 +4,7 @@
 #include "node/node.h"
 #include "node/nodeconfig.h"
 #include "tcpstreamsdata/tcpstream.h"
+#include "payloadtokenizer.h"
 #include <QObject>
 #include <QString>
 #include <QSharedPointer>
@@ -19,6 +20,17 @@ class CTcpStreamFeaturesNode: public CNode
     QSharedPointer<CTableData> m_table;
     // How many streams have we processed.
     qint32 m_processed_streams;
+    // Parameters resolved when the node starts.
+    bool m_timestamp;
+    qint32 m_timezone; // In seconds.
+    bool m_split_dest_ip;
+    qint32 m_dest_ip_octets;
+    bool m_split_src_ip;
+    qint32 m_src_ip_octets;
+    quint32 m_word_count;
+    quint32 m_word_length;
+    bool m_packet_count;
+    bool m_numeric;
 
   public:
     // Constructor
@@ -34,9 +46,15 @@ class CTcpStreamFeaturesNode: public CNode
 
   private:
     bool createFeaturesTable();
-    void extractFeatures(const CTcpStream &tcp_stream);
-    QString buildFlagsString(quint8 flags);
-    QStringList extractStrings(const QVector<quint8> &data);
+    // Append the features of a stream to 'row'. Safe to call from several
+    // ... threads at once, each with its own tokenizer.
+    void extractFeatures(const CTcpStream &tcp_stream,
+                         CPayloadTokenizer &tokenizer,
+                         QList<QVariant> &row) const;
+    // Append 'address' to 'row', or its 'octets' least significant octets as
+    // ... different attributes if 'split' is set.
+    void appendAddress(quint32 address, bool split, qint32 octets,
+                       QList<QVariant> &row) const;
 };
 
 #endif // TCPSTREAMFEATURESNODE_H
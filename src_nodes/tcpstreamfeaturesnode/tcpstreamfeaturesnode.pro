@@ -1,4 +1,5 @@
 QT += core
+QT += concurrent
 QT -= gui
 
 TARGET = tcpstreamfeaturesnode
@@ -29,9 +30,13 @@ QMAKE_CLEAN += $$DESTDIR/*$$TARGET*
 
 HEADERS += \
     tcpstreamfeaturesnode.h \
+    payloadtokenizer.h \
+    stringpool.h \
     interface.h
 
 SOURCES += \
     tcpstreamfeaturesnode.cpp \
+    payloadtokenizer.cpp \
+    stringpool.cpp \
     interface.cpp
 